@@ -0,0 +1,64 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "http/compression.h"
+#include "http/request.h"
+#include "http/response.h"
+
+
+using namespace std;
+
+
+// cpu spent by the compression middleware against the bytes it saves on a
+// generated json payload, per level and for the memoized cacheable path.
+// usage: bench_compression [iterations] [payload_bytes]
+static string MakeJson(size_t size) {
+	string json = "[";
+	for (int i = 0; json.size() < size; i++) {
+		json += "{\"id\":" + std::to_string(i) + ",\"name\":\"item" + std::to_string(i % 97) +
+			"\",\"price\":" + std::to_string((i * 7919) % 10000 / 100.0) + ",\"tags\":[\"moss\",\"http\"],\"active\":" +
+			(i % 3 ? "true" : "false") + "},";
+	}
+	json.back() = ']';
+	return json;
+}
+
+static void Run(const char* name, int level, bool cacheable, int iterations, const string& payload) {
+	auto compression = std::make_shared<moss::http::Compression>(level);
+	auto request = std::make_shared<moss::http::Request>(nullptr);
+	request->SetHeader("Accept-Encoding", "gzip, deflate, br");
+	auto start = std::chrono::steady_clock::now();
+	size_t bytes_out = 0;
+	for (int i = 0; i < iterations; i++) {
+		auto response = std::make_shared<moss::http::Response>(nullptr);
+		response->SetStatusCode(200);
+		response->SetHeader("Content-Type", "application/json");
+		response->SetPayload(payload);
+		response->SetCacheable(cacheable);
+		compression->OnAfter(request, response);
+		bytes_out += response->Payload().size();
+	}
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	double saved_kb = ((double)payload.size() * iterations - bytes_out) / 1024;
+	printf("%-12s %-8.3f %-14.1f %-12.1f %-12.3f\n", name, (double)bytes_out / iterations / payload.size(),
+		elapsed / iterations, payload.size() * (double)iterations / elapsed, saved_kb > 0 ? elapsed / saved_kb : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+	int payload_bytes = argc > 2 ? atoi(argv[2]) : 16 * 1024;
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	string payload = MakeJson(payload_bytes > 0 ? payload_bytes : 1);
+	printf("payload %zu bytes\n", payload.size());
+	printf("%-12s %-8s %-14s %-12s %-12s\n", "case", "ratio", "us/response", "MB/s", "us/KB saved");
+	Run("level 1", 1, false, iterations, payload);
+	Run("level 6", 6, false, iterations, payload);
+	Run("level 9", 9, false, iterations, payload);
+	Run("level 6 memo", 6, true, iterations, payload);
+	return 0;
+}
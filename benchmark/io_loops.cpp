@@ -0,0 +1,179 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+
+
+using namespace std;
+
+
+// requests/sec of a keep-alive GET against servers running 1..N io loops.
+// usage: bench_io_loops [max_loops] [connections] [seconds] [port] [pool|inline]
+class Ping
+	: public moss::http::Route {
+public:
+	Ping()
+		: moss::http::Route("GET", "/ping") {
+	}
+
+	int Process(shared_ptr<moss::http::Request> /*request*/, shared_ptr<moss::http::Response> response) override {
+		response->SetPayload("pong");
+		return 0;
+	}
+};
+
+static void RunServer(int port, int loops, moss::http::ExecutionPolicy policy) {
+	auto application = std::make_shared<moss::http::Application>();
+	auto ping = std::make_shared<Ping>();
+	ping->SetExecutionPolicy(policy);
+	application->Install(ping);
+	auto server = std::make_shared<moss::HttpServer>();
+	server->Install(application);
+	server->SetIoWorkers(loops);
+	server->SetReusePort(true);
+	server->SetMaxKeepAliveRequests(0);
+	if (0 != server->Start("127.0.0.1", port, loops * 2)) {
+		_exit(1);
+	}
+	for (;;) {
+		std::this_thread::sleep_for(std::chrono::seconds(10));
+	}
+}
+
+static int Connect(int port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	if (0 != connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool WaitReady(int port) {
+	for (int i = 0; i < 100; i++) {
+		int fd = Connect(port);
+		if (fd >= 0) {
+			close(fd);
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	return false;
+}
+
+static bool RoundTrip(int fd, const string& request, string& buffer) {
+	if (send(fd, request.data(), request.size(), 0) != (ssize_t)request.size())
+		return false;
+	char chunk[4096];
+	for (;;) {
+		size_t head = buffer.find("\r\n\r\n");
+		if (head != string::npos) {
+			size_t length = 0;
+			size_t pos = buffer.find("Content-Length: ");
+			if (pos != string::npos && pos < head) {
+				length = strtoul(buffer.c_str() + pos + 16, nullptr, 10);
+			}
+			if (buffer.size() >= head + 4 + length) {
+				buffer.erase(0, head + 4 + length);
+				return true;
+			}
+		}
+		ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+		if (n <= 0)
+			return false;
+		buffer.append(chunk, n);
+	}
+}
+
+static double RunClients(int port, int connections, int seconds) {
+	const string request = "GET /ping HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+	std::atomic_bool stopped(false);
+	std::atomic<int64_t> completed(0);
+	vector<std::thread> clients;
+	for (int i = 0; i < connections; i++) {
+		clients.emplace_back([&]() {
+			string buffer;
+			int fd = Connect(port);
+			int64_t count = 0;
+			while (fd >= 0 && !stopped) {
+				if (!RoundTrip(fd, request, buffer))
+					break;
+				count++;
+			}
+			if (fd >= 0) {
+				close(fd);
+			}
+			completed += count;
+		});
+	}
+	auto start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	stopped = true;
+	for (auto& client : clients) {
+		client.join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return completed / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+	int max_loops = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+	int connections = argc > 2 ? atoi(argv[2]) : 64;
+	int seconds = argc > 3 ? atoi(argv[3]) : 5;
+	int port = argc > 4 ? atoi(argv[4]) : 19090;
+	auto policy = moss::http::ExecutionPolicy::Pool;
+	if (argc > 5 && 0 == strcmp(argv[5], "inline")) {
+		policy = moss::http::ExecutionPolicy::Inline;
+	}
+	if (max_loops < 1) {
+		max_loops = 1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	printf("%-8s %-12s %-12s\n", "loops", "requests/s", "speedup");
+	double baseline = 0;
+	for (int loops = 1; loops <= max_loops; loops *= 2) {
+		int listen_port = port + loops;
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid == 0) {
+			RunServer(listen_port, loops, policy);
+		}
+		if (pid < 0 || !WaitReady(listen_port)) {
+			fprintf(stderr, "server with %d loops failed to start\n", loops);
+			return 1;
+		}
+		double rps = RunClients(listen_port, connections, seconds);
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		if (baseline == 0) {
+			baseline = rps;
+		}
+		printf("%-8d %-12.0f %-12.2f\n", loops, rps, baseline > 0 ? rps / baseline : 0.0);
+		if (loops < max_loops && loops * 2 > max_loops) {
+			loops = max_loops / 2;
+		}
+	}
+	return 0;
+}
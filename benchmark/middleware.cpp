@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/middleware.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+
+
+using namespace std;
+
+
+// per-request cost of running a route through chains of no-op middleware,
+// and of a route outside the group the middleware is bound to.
+// usage: bench_middleware [iterations]
+class Noop
+	: public moss::http::Route {
+public:
+	Noop(const string& path)
+		: moss::http::Route("GET", path) {
+	}
+
+	int Process(shared_ptr<moss::http::Request> /*request*/, shared_ptr<moss::http::Response> /*response*/) override {
+		return 0;
+	}
+};
+
+class Pass
+	: public moss::http::Middleware {
+public:
+	Pass()
+		: moss::http::Middleware("pass") {
+	}
+};
+
+class BenchServer
+	: public moss::HttpServer {
+public:
+	using moss::HttpServer::Find;
+	using moss::HttpServer::Process;
+};
+
+static double Run(int middlewares, const string& group, const string& url, int iterations) {
+	auto application = std::make_shared<moss::http::Application>();
+	application->Install(std::make_shared<Noop>("/api/items"));
+	application->Install(std::make_shared<Noop>("/health"));
+	for (int i = 0; i < middlewares; i++) {
+		application->Install(std::make_shared<Pass>(), group);
+	}
+	auto server = std::make_shared<BenchServer>();
+	server->Install(application);
+	auto request = std::make_shared<moss::http::Request>(nullptr);
+	request->SetMethod("GET");
+	request->SetUrl(url);
+	auto route = server->Find(request);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		auto response = std::make_shared<moss::http::Response>(nullptr);
+		server->Process(route, request, response);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	printf("%-14s %-14s %-14s\n", "middlewares", "ns/request", "outside group");
+	for (int middlewares : { 0, 1, 4, 16, 64 }) {
+		printf("%-14d %-14.1f %-14.1f\n", middlewares, Run(middlewares, "", "/api/items", iterations),
+			Run(middlewares, "/api", "/health", iterations));
+	}
+	return 0;
+}
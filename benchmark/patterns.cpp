@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+
+
+using namespace std;
+
+
+// route lookup against patterns that make a backtracking matcher blow up,
+// per engine, for growing path lengths. std::regex stops once one lookup
+// takes longer than the budget, the nfa is expected to grow linearly.
+// usage: bench_patterns [max_length] [budget_ms]
+class Noop
+	: public moss::http::Route {
+public:
+	Noop(const string& path, moss::http::PatternEngine engine)
+		: moss::http::Route("GET", path) {
+		SetPatternEngine(engine);
+	}
+
+	int Process(shared_ptr<moss::http::Request> /*request*/, shared_ptr<moss::http::Response> /*response*/) override {
+		return 0;
+	}
+};
+
+class BenchServer
+	: public moss::HttpServer {
+public:
+	using moss::HttpServer::Find;
+};
+
+static shared_ptr<BenchServer> MakeServer(const string& pattern, moss::http::PatternEngine engine) {
+	auto application = std::make_shared<moss::http::Application>();
+	if (0 != application->Install(std::make_shared<Noop>(pattern, engine)))
+		return nullptr;
+	auto server = std::make_shared<BenchServer>();
+	server->Install(application);
+	return server;
+}
+
+// ns per lookup, repeated for at least 20ms.
+static double LookupNs(shared_ptr<BenchServer> server, const string& url) {
+	auto request = std::make_shared<moss::http::Request>(nullptr);
+	request->SetMethod("GET");
+	request->SetUrl(url);
+	int iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::milliseconds(20);
+	do {
+		server->Find(request);
+		iterations++;
+	} while (std::chrono::steady_clock::now() < deadline);
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+static void Run(const char* pattern, const string& prefix, char fill, int max_length, double budget_ms) {
+	auto nfa = MakeServer(pattern, moss::http::PatternEngine::Nfa);
+	auto regex = MakeServer(pattern, moss::http::PatternEngine::Regex);
+	printf("\n%s\n%-10s %-16s %-16s\n", pattern, "length", "nfa ns", "regex ns");
+	bool regex_done = !regex;
+	for (int length = 8; length <= max_length; length *= 2) {
+		string url = prefix + string(length, fill);
+		double nfa_ns = nfa ? LookupNs(nfa, url) : 0;
+		if (regex_done) {
+			printf("%-10d %-16.1f %-16s\n", length, nfa_ns, "-");
+			continue;
+		}
+		double regex_ns = LookupNs(regex, url);
+		printf("%-10d %-16.1f %-16.1f\n", length, nfa_ns, regex_ns);
+		regex_done = regex_ns > budget_ms * 1e6;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int max_length = argc > 1 ? atoi(argv[1]) : 4096;
+	double budget_ms = argc > 2 ? atof(argv[2]) : 50;
+	Run("~/files/{path:(.*)*x}", "/files/", 'a', max_length, budget_ms);
+	Run("~/files/{path:(a|aa)+x}", "/files/", 'a', max_length, budget_ms);
+	Run("~/files/{path:[a-z]+\\.json}", "/files/", 'a', max_length, budget_ms);
+	return 0;
+}
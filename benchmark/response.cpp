@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "http/response.h"
+#include "third_party/http_parser/http_parser.h"
+
+
+using namespace std;
+
+
+// ns per serialized response, the previous ostringstream serializer against Response::Serialize.
+// usage: bench_response [iterations] [payload_bytes]
+static shared_ptr<string> SerializeWithStream(int status_code, const unordered_map<string, string>& headers, const string& payload) {
+	ostringstream oss;
+	oss << "HTTP/1.1 " << status_code << " " << http_status_str(http_status(status_code)) << "\r\n";
+	for (auto it = headers.begin(); it != headers.end(); ++it) {
+		oss << it->first << ": " << it->second << "\r\n";
+	}
+	oss << "\r\n";
+	oss << payload;
+	return std::make_shared<string>(std::move(oss.str()));
+}
+
+static double NsPerOp(std::chrono::steady_clock::time_point start, int iterations) {
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+	int payload_bytes = argc > 2 ? atoi(argv[2]) : 512;
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	if (payload_bytes < 0) {
+		payload_bytes = 0;
+	}
+	const string payload(payload_bytes, 'x');
+	size_t bytes = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		unordered_map<string, string> headers;
+		headers["Content-Type"] = "text/plain";
+		headers["Content-Length"] = std::to_string(payload.size());
+		headers["Server"] = "moss";
+		headers["Connection"] = "keep-alive";
+		string body = payload;
+		bytes += SerializeWithStream(200, headers, body)->size();
+	}
+	double stream = NsPerOp(start, iterations);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		moss::http::Response response(nullptr);
+		response.SetStatusCode(200);
+		response.SetHeader("Content-Type", "text/plain");
+		response.SetPayload(string(payload));
+		response.SetHeader("Server", "moss");
+		response.SetHeader("Connection", "keep-alive");
+		bytes += response.Serialize()->size();
+	}
+	double serializer = NsPerOp(start, iterations);
+
+	printf("%-24s %-12s\n", "case", "ns/response");
+	printf("%-24s %-12.1f\n", "ostringstream", stream);
+	printf("%-24s %-12.1f\n", "Response::Serialize", serializer);
+	return bytes > 0 ? 0 : 1;
+}
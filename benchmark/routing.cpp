@@ -0,0 +1,191 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "utils/url.h"
+
+
+using namespace std;
+
+
+// per-request cost of building a request and resolving its route, with the
+// url split lazily by Request against an eagerly parsed moss::Url, then the
+// lookup alone against route tables of growing size and virtual hosts.
+// usage: bench_routing [iterations] [routes] [max_table_routes]
+class Noop
+	: public moss::http::Route {
+public:
+	Noop(const string& path)
+		: moss::http::Route("GET", path) {
+	}
+
+	int Process(shared_ptr<moss::http::Request> /*request*/, shared_ptr<moss::http::Response> /*response*/) override {
+		return 0;
+	}
+};
+
+class BenchServer
+	: public moss::HttpServer {
+public:
+	using moss::HttpServer::Find;
+};
+
+static double NsPerOp(std::chrono::steady_clock::time_point start, int iterations) {
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// repeats the lookup for about 200ms, slow tables just get fewer iterations.
+static double LookupNs(shared_ptr<BenchServer> server, shared_ptr<moss::http::Request> request) {
+	int iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::milliseconds(200);
+	do {
+		for (int i = 0; i < 16; i++) {
+			server->Find(request);
+		}
+		iterations += 16;
+	} while (std::chrono::steady_clock::now() < deadline);
+	return NsPerOp(start, iterations);
+}
+
+// half static routes, half routes with a path parameter, every tenth one a
+// raw regex pattern left to the fallback list.
+static void RunTable(int routes) {
+	auto application = std::make_shared<moss::http::Application>();
+	int last_regex = 0;
+	for (int i = 0; i < routes; i++) {
+		if (i % 10 == 9) {
+			application->Install(std::make_shared<Noop>("~/api/v3/res" + std::to_string(i) + "/(\\d+)"));
+			last_regex = i;
+		} else if (i % 2) {
+			application->Install(std::make_shared<Noop>("~/api/v2/res" + std::to_string(i) + "/{id}"));
+		} else {
+			application->Install(std::make_shared<Noop>("/api/v1/res" + std::to_string(i) + "/list"));
+		}
+	}
+	auto server = std::make_shared<BenchServer>();
+	server->Install(application);
+	auto lookup = [&](const string& url) {
+		auto request = std::make_shared<moss::http::Request>(nullptr);
+		request->SetMethod("GET");
+		request->SetUrl(url);
+		return LookupNs(server, request);
+	};
+	int last_static = (routes - 1) / 2 * 2;
+	int last_param = routes > 1 ? (routes / 2) * 2 - 1 : 1;
+	if (last_param % 10 == 9) {
+		last_param -= 2;
+	}
+	printf("%-8d %-14.1f %-14.1f %-14.1f %-14.1f\n", routes,
+		lookup("/api/v1/res" + std::to_string(last_static) + "/list"),
+		lookup("/api/v2/res" + std::to_string(last_param) + "/42"),
+		lookup("/api/v3/res" + std::to_string(last_regex) + "/42"),
+		lookup("/api/v4/missing/path"));
+}
+
+// one application per virtual host, each with a root and an /api prefix.
+static void RunHosts(int hosts) {
+	auto server = std::make_shared<BenchServer>();
+	for (int i = 0; i < hosts; i++) {
+		auto root = std::make_shared<moss::http::Application>();
+		root->SetHost("app" + std::to_string(i) + ".example.com");
+		root->Install(std::make_shared<Noop>("/index"));
+		server->Install(root);
+		auto api = std::make_shared<moss::http::Application>("/api");
+		api->SetHost("app" + std::to_string(i) + ".example.com");
+		api->Install(std::make_shared<Noop>("~/items/{id}"));
+		server->Install(api);
+	}
+	auto lookup = [&](const string& host, const string& url) {
+		auto request = std::make_shared<moss::http::Request>(nullptr);
+		request->SetMethod("GET");
+		request->SetUrl(url);
+		request->SetHeader("Host", host);
+		return LookupNs(server, request);
+	};
+	string last = "app" + std::to_string(hosts - 1) + ".example.com:8080";
+	printf("%-8d %-14.1f %-14.1f %-14.1f\n", hosts, lookup(last, "/index"), lookup(last, "/api/items/42"), lookup("unknown.example.com", "/index"));
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+	int routes = argc > 2 ? atoi(argv[2]) : 64;
+	int max_table_routes = argc > 3 ? atoi(argv[3]) : 10000;
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	if (routes < 1) {
+		routes = 1;
+	}
+	auto application = std::make_shared<moss::http::Application>();
+	for (int i = 0; i < routes; i++) {
+		application->Install(std::make_shared<Noop>("/api/v1/item" + std::to_string(i)));
+	}
+	auto server = std::make_shared<BenchServer>();
+	server->Install(application);
+
+	vector<string> urls;
+	for (int i = 0; i < 16; i++) {
+		urls.push_back("/api/v1/item" + std::to_string(i * routes / 16) + "?name=world&page=" + std::to_string(i) + "&sort=desc");
+	}
+
+	size_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		auto request = std::make_shared<moss::http::Request>(nullptr);
+		request->SetMethod("GET");
+		request->SetUrl(urls[i % urls.size()]);
+		request->SetHeader("Host", "example.com");
+		if (server->Find(request)) {
+			found++;
+		}
+	}
+	double route_only = NsPerOp(start, iterations);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		auto request = std::make_shared<moss::http::Request>(nullptr);
+		request->SetMethod("GET");
+		request->SetUrl(urls[i % urls.size()]);
+		request->SetHeader("Host", "example.com");
+		if (server->Find(request) && !request->Query("name").empty()) {
+			found++;
+		}
+	}
+	double route_query = NsPerOp(start, iterations);
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		moss::Url url(urls[i % urls.size()]);
+		url.Set("host", "example.com");
+		if (!url.Path().empty() && !url.Query("name").empty()) {
+			found++;
+		}
+	}
+	double eager_url = NsPerOp(start, iterations);
+
+	printf("%-24s %-12s\n", "case", "ns/request");
+	printf("%-24s %-12.1f\n", "route", route_only);
+	printf("%-24s %-12.1f\n", "route+query", route_query);
+	printf("%-24s %-12.1f\n", "eager moss::Url", eager_url);
+
+	printf("\n%-8s %-14s %-14s %-14s %-14s\n", "routes", "static ns", "param ns", "regex ns", "miss ns");
+	for (int table_routes = 10; table_routes <= max_table_routes; table_routes *= 10) {
+		RunTable(table_routes);
+	}
+
+	printf("\n%-8s %-14s %-14s %-14s\n", "hosts", "root ns", "prefix ns", "miss ns");
+	for (int hosts = 1; hosts <= 1000; hosts *= 10) {
+		RunHosts(hosts);
+	}
+	return found > 0 ? 0 : 1;
+}
@@ -5,17 +5,22 @@
 #include "middleware.h"
 #include "request.h"
 #include "response.h"
+#include "utils/logger.h"
 
 
 namespace moss {
 	namespace http {
 		Application::Application()
-			: routes_(std::make_shared<Routes>()) {
+			: routes_(std::make_shared<Routes>()),
+			policy_(ExecutionPolicy::Pool),
+			pattern_engine_(PatternEngine::Nfa) {
 		}
 
 		Application::Application(const string& prefix)
 			: routes_(std::make_shared<Routes>()),
-			prefix_(prefix) {
+			prefix_(prefix),
+			policy_(ExecutionPolicy::Pool),
+			pattern_engine_(PatternEngine::Nfa) {
 		}
 
 		Application::~Application() {
@@ -25,42 +30,118 @@ namespace moss {
 			return "moss/1.0";
 		}
 
-		void Application::Install(shared_ptr<Route> route) {
+		void Application::SetHost(const string& host) {
+			host_ = host;
+		}
+
+		string Application::Host() const {
+			return host_;
+		}
+
+		string Application::Prefix() const {
+			return prefix_;
+		}
+
+		int Application::Install(shared_ptr<Route> route) {
 			if (!route || route->Path().empty())
-				return;
+				return -1;
+			PatternEngine engine = route->GetPatternEngine();
+			if (engine == PatternEngine::Default) {
+				engine = pattern_engine_;
+			}
+			string error;
+			if (0 != routes_->Install(route, engine, error)) {
+				logger::Error() << "route rejected, " << error;
+				return -1;
+			}
 			route->AttachApplication(shared_from_this());
-			routes_->Install(route);
+			Compile(route.get());
+			return 0;
 		}
 
 		void Application::Install(shared_ptr<Middleware> middleware) {
+			Install(middleware, string());
+		}
+
+		void Application::Install(shared_ptr<Middleware> middleware, const string& path_prefix) {
 			if (!middleware)
 				return;
 			middleware->AttachApplication(shared_from_this());
-			if (!middleware_) {
-				middleware_ = middleware;
-			} else {
-				middleware_->Append(middleware);
+			string prefix = path_prefix;
+			while (!prefix.empty() && prefix.back() == '/') {
+				prefix.pop_back();
+			}
+			middlewares_.push_back(MiddlewareBinding{ middleware, prefix });
+			for (auto& route : routes_->All()) {
+				Compile(route.get());
+			}
+		}
+
+		void Application::SetExecutionPolicy(ExecutionPolicy policy) {
+			policy_ = policy == ExecutionPolicy::Default ? ExecutionPolicy::Pool : policy;
+		}
+
+		ExecutionPolicy Application::GetExecutionPolicy() const {
+			return policy_;
+		}
+
+		void Application::SetPatternEngine(PatternEngine engine) {
+			pattern_engine_ = engine == PatternEngine::Default ? PatternEngine::Nfa : engine;
+		}
+
+		PatternEngine Application::GetPatternEngine() const {
+			return pattern_engine_;
+		}
+
+		shared_ptr<Route> Application::Find(shared_ptr<Request> request, const StringView& route_path, unordered_map<string, string>& args) {
+			return routes_->Find(request->Method(), route_path, args);
+		}
+
+		bool Application::IsInline(shared_ptr<Route> route) const {
+			ExecutionPolicy policy = route->GetExecutionPolicy();
+			if (policy == ExecutionPolicy::Default) {
+				policy = policy_;
 			}
+			return policy == ExecutionPolicy::Inline && !route->blocking_;
 		}
 
-		int Application::Process(shared_ptr<Request> request, shared_ptr<Response> response) {
-			unordered_map<string, string> args;
-			string route_path = request->Path();
-			if (!prefix_.empty() && 0 == route_path.find(prefix_)) {
-				route_path = route_path.substr(prefix_.length());
+		int Application::Process(shared_ptr<Route> route, shared_ptr<Request> request, shared_ptr<Response> response) {
+			const auto& chain = route->chain_;
+			size_t entered = 0;
+			while (entered < chain.size() && chain[entered]->OnBefore(request, response) >= 0) {
+				entered++;
 			}
-			auto route = routes_->Find(request->Method(), route_path, args);
-			if (!route)
-				return -1;
-			request->SetPathArgs(args);
-			if (middleware_) {
-				middleware_->Process(route, request, response);
-			} else {
+			if (entered == chain.size()) {
 				response->SetStatusCode(200);
 				route->Process(request, response);
 			}
+			while (entered > 0) {
+				chain[--entered]->OnAfter(request, response);
+			}
 			return 0;
 		}
+
+		// application wide and group middleware in install order, then the
+		// route's own. a group covers its prefix on a segment boundary, pattern
+		// routes are compared without the leading '~'.
+		void Application::Compile(Route* route) {
+			StringView path(route->path_);
+			if (path.StartsWith("~")) {
+				path = path.substr(1);
+			}
+			route->chain_.clear();
+			for (auto& binding : middlewares_) {
+				const string& prefix = binding.path_prefix;
+				if (!prefix.empty() && (!path.StartsWith(prefix) || (path.size() > prefix.size() && path[prefix.size()] != '/')))
+					continue;
+				route->chain_.push_back(binding.middleware);
+			}
+			route->chain_.insert(route->chain_.end(), route->middlewares_.begin(), route->middlewares_.end());
+			route->blocking_ = false;
+			for (auto& middleware : route->chain_) {
+				route->blocking_ = route->blocking_ || middleware->IsBlocking();
+			}
+		}
 	} // namespace http
 } // namespace moss
 
@@ -2,16 +2,22 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include "route.h"
+#include "utils/string_view.h"
 #include "moss_exports.h"
 
 
 using std::shared_ptr;
 using std::string;
+using std::unordered_map;
+using std::vector;
 namespace moss {
 	class HttpServer;
 	namespace http {
-		class Route;
 		class Routes;
+		class Applications;
 		class Middleware;
 		class Request;
 		class Response;
@@ -19,19 +25,48 @@ namespace moss {
 		class Application
 			: public std::enable_shared_from_this<Application> {
 			friend class moss::HttpServer;
+			friend class Applications;
+			friend class Route;
+			struct MiddlewareBinding {
+				shared_ptr<Middleware> middleware;
+				// routes whose path starts with it, empty for every route.
+				string path_prefix;
+			};
 		public:
 			MOSS_EXPORT Application();
 			MOSS_EXPORT Application(const string& prefix);
 			virtual ~Application();
 			MOSS_EXPORT virtual string Name() const;
-			MOSS_EXPORT void Install(shared_ptr<Route> route);
+			// serves only requests for host (port ignored, case-insensitive), empty
+			// serves any host. takes effect when installed on the server.
+			MOSS_EXPORT void SetHost(const string& host);
+			MOSS_EXPORT string Host() const;
+			MOSS_EXPORT string Prefix() const;
+			// -1 for a route without a path or with a pattern that does not compile.
+			MOSS_EXPORT int Install(shared_ptr<Route> route);
 			MOSS_EXPORT void Install(shared_ptr<Middleware> middleware);
+			// middleware for the group of routes under path_prefix, e.g. "/admin".
+			MOSS_EXPORT void Install(shared_ptr<Middleware> middleware, const string& path_prefix);
+			MOSS_EXPORT void SetExecutionPolicy(ExecutionPolicy policy);
+			MOSS_EXPORT ExecutionPolicy GetExecutionPolicy() const;
+			// engine for routes left at PatternEngine::Default, Nfa unless set
+			// before the routes are installed.
+			MOSS_EXPORT void SetPatternEngine(PatternEngine engine);
+			MOSS_EXPORT PatternEngine GetPatternEngine() const;
 		protected:
-			int Process(shared_ptr<Request> request, shared_ptr<Response> response);
+			// route_path is the request path with the prefix already removed.
+			shared_ptr<Route> Find(shared_ptr<Request> request, const StringView& route_path, unordered_map<string, string>& args);
+			bool IsInline(shared_ptr<Route> route) const;
+			int Process(shared_ptr<Route> route, shared_ptr<Request> request, shared_ptr<Response> response);
+			// rebuilds the middleware chain of route.
+			void Compile(Route* route);
 		private:
 			shared_ptr<Routes> routes_;
-			shared_ptr<Middleware> middleware_;
+			vector<MiddlewareBinding> middlewares_;
 			string prefix_;
+			string host_;
+			ExecutionPolicy policy_;
+			PatternEngine pattern_engine_;
 		};
 	} // namespace http
 } // namespace moss
@@ -0,0 +1,132 @@
+#include "applications.h"
+
+#include "application.h"
+#include "request.h"
+
+
+namespace moss {
+	namespace http {
+		namespace {
+			char LowerCase(char ch) {
+				return (ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch;
+			}
+
+			// the host without its port, "[::1]:8080" keeps the brackets.
+			StringView HostName(const StringView& host) {
+				size_t colon = StringView::npos;
+				for (size_t i = host.size(); i > 0; i--) {
+					if (host[i - 1] == ':') {
+						colon = i - 1;
+						break;
+					}
+					if (host[i - 1] == ']')
+						break;
+				}
+				return colon == StringView::npos ? host : host.substr(0, colon);
+			}
+
+			// "" and "/" serve everything, otherwise no trailing '/'.
+			string NormalizePrefix(const string& prefix) {
+				string normalized = prefix;
+				while (!normalized.empty() && normalized.back() == '/') {
+					normalized.pop_back();
+				}
+				return normalized;
+			}
+		}
+
+		size_t Applications::HostHash::operator()(const StringView& host) const {
+			size_t hash = (size_t)14695981039346656037ULL;
+			for (char ch : host) {
+				hash ^= (unsigned char)LowerCase(ch);
+				hash *= (size_t)1099511628211ULL;
+			}
+			return hash;
+		}
+
+		bool Applications::HostEqual::operator()(const StringView& left, const StringView& right) const {
+			return left.EqualsIgnoreCase(right);
+		}
+
+		int Applications::Install(shared_ptr<Application> application) {
+			Node* node = &any_host_;
+			string host = HostName(application->Host());
+			if (!host.empty()) {
+				auto it = hosts_.find(host);
+				if (it == hosts_.end()) {
+					unique_ptr<Host> created(new Host());
+					created->name = host;
+					StringView name(created->name);
+					it = hosts_.insert(std::make_pair(name, std::move(created))).first;
+				}
+				node = &it->second->root;
+			}
+			string prefix = NormalizePrefix(application->Prefix());
+			size_t pos = 0;
+			while (pos < prefix.size()) {
+				size_t index = node->indices.find(prefix[pos]);
+				if (index == string::npos) {
+					unique_ptr<Node> child(new Node());
+					child->prefix = prefix.substr(pos);
+					node->indices.append(1, prefix[pos]);
+					node->children.push_back(std::move(child));
+					node = node->children.back().get();
+					break;
+				}
+				Node* child = node->children[index].get();
+				size_t common = 0;
+				while (common < child->prefix.size() && pos + common < prefix.size() && child->prefix[common] == prefix[pos + common]) {
+					common++;
+				}
+				if (common < child->prefix.size()) {
+					unique_ptr<Node> split(new Node());
+					split->prefix = child->prefix.substr(0, common);
+					split->indices.append(1, child->prefix[common]);
+					child->prefix = child->prefix.substr(common);
+					split->children.push_back(std::move(node->children[index]));
+					node->children[index] = std::move(split);
+					child = node->children[index].get();
+				}
+				node = child;
+				pos += common;
+			}
+			if (node->application)
+				return -1;
+			node->application = application;
+			return 0;
+		}
+
+		shared_ptr<Route> Applications::Find(shared_ptr<Request> request, unordered_map<string, string>& args) const {
+			StringView path = request->Path();
+			if (!hosts_.empty()) {
+				auto it = hosts_.find(HostName(request->Host()));
+				if (it != hosts_.end()) {
+					auto route = Find(&it->second->root, path, 0, request, args);
+					if (route)
+						return route;
+				}
+			}
+			return Find(&any_host_, path, 0, request, args);
+		}
+
+		// deeper prefixes first, so an application only sees what no more specific
+		// one routes.
+		shared_ptr<Route> Applications::Find(const Node* node, const StringView& path, size_t pos, shared_ptr<Request> request, unordered_map<string, string>& args) const {
+			if (pos < path.size()) {
+				size_t index = node->indices.find(path[pos]);
+				if (index != string::npos) {
+					const Node* child = node->children[index].get();
+					if (path.substr(pos).StartsWith(child->prefix)) {
+						auto route = Find(child, path, pos + child->prefix.size(), request, args);
+						if (route)
+							return route;
+					}
+				}
+			}
+			if (!node->application || (pos < path.size() && path[pos] != '/'))
+				return nullptr;
+			return node->application->Find(request, pos < path.size() ? path.substr(pos) : StringView("/"), args);
+		}
+	} // namespace http
+} // namespace moss
+
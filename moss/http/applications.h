@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils/string_view.h"
+
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+namespace moss {
+	namespace http {
+		class Application;
+		class Request;
+		class Route;
+		// applications indexed by host, then by path prefix in a radix trie. a
+		// request goes to the longest prefix matching on a segment boundary that
+		// routes it, trying its host's applications before the host-less ones.
+		class Applications {
+			struct Node {
+				string prefix;
+				string indices;
+				vector<unique_ptr<Node>> children;
+				shared_ptr<Application> application;
+			};
+			struct Host {
+				string name;
+				Node root;
+			};
+			struct HostHash {
+				size_t operator()(const StringView& host) const;
+			};
+			struct HostEqual {
+				bool operator()(const StringView& left, const StringView& right) const;
+			};
+			using Hosts = unordered_map<StringView, unique_ptr<Host>, HostHash, HostEqual>;
+		public:
+			// -1 when another application already serves the same host and prefix.
+			int Install(shared_ptr<Application> application);
+			shared_ptr<Route> Find(shared_ptr<Request> request, unordered_map<string, string>& args) const;
+		private:
+			shared_ptr<Route> Find(const Node* node, const StringView& path, size_t pos, shared_ptr<Request> request, unordered_map<string, string>& args) const;
+			Hosts hosts_;
+			Node any_host_;
+		};
+	} // namespace http
+} // namespace moss
+
@@ -0,0 +1,243 @@
+#include "compression.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include "known_header.h"
+#include "request.h"
+#include "response.h"
+#include "utils/string_view.h"
+
+
+namespace moss {
+	namespace http {
+		namespace {
+			enum class Encoding {
+				Identity,
+				Gzip,
+				Deflate
+			};
+
+			// q value of a single "coding;q=0.5" element, 1 when absent.
+			double Quality(const StringView& params) {
+				size_t pos = params.find(StringView("q="));
+				if (pos == StringView::npos)
+					return 1.0;
+				return atof(params.substr(pos + 2).str().c_str());
+			}
+
+			// whether a comma separated header value lists token, or "*".
+			bool ListsToken(const StringView& list, const StringView& token) {
+				size_t pos = 0;
+				while (pos < list.size()) {
+					size_t end = list.find(',', pos);
+					if (end == StringView::npos) {
+						end = list.size();
+					}
+					StringView element = list.substr(pos, end - pos).Strip();
+					if (element == "*" || element.EqualsIgnoreCase(token))
+						return true;
+					pos = end + 1;
+				}
+				return false;
+			}
+
+			// gzip is preferred when both are equally acceptable.
+			Encoding Negotiate(const StringView& accept_encoding) {
+				double gzip = -1, deflate = -1, any = 0;
+				size_t pos = 0;
+				while (pos < accept_encoding.size()) {
+					size_t end = accept_encoding.find(',', pos);
+					if (end == StringView::npos) {
+						end = accept_encoding.size();
+					}
+					StringView element = accept_encoding.substr(pos, end - pos);
+					pos = end + 1;
+					size_t semicolon = element.find(';');
+					StringView coding = element.substr(0, semicolon).Strip();
+					double quality = semicolon == StringView::npos ? 1.0 : Quality(element.substr(semicolon + 1));
+					if (coding.EqualsIgnoreCase("gzip") || coding.EqualsIgnoreCase("x-gzip")) {
+						gzip = quality;
+					} else if (coding.EqualsIgnoreCase("deflate")) {
+						deflate = quality;
+					} else if (coding == "*") {
+						any = quality;
+					}
+				}
+				// codings not listed get the quality of "*", if any.
+				if (gzip < 0) {
+					gzip = any;
+				}
+				if (deflate < 0) {
+					deflate = any;
+				}
+				if (gzip > 0 && gzip >= deflate)
+					return Encoding::Gzip;
+				if (deflate > 0)
+					return Encoding::Deflate;
+				return Encoding::Identity;
+			}
+		}
+
+		Compression::Compression(int level/* = 6*/)
+			: Middleware("compression"),
+			level_(level),
+			min_size_(1024),
+			content_types_({ "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml" }),
+			cache_capacity_(256),
+			responses_(0),
+			cache_hits_(0),
+			bytes_in_(0),
+			bytes_out_(0),
+			compress_ns_(0) {
+		}
+
+		void Compression::SetLevel(int level) {
+			level_ = level;
+			std::lock_guard<mutex> lock(cache_mutex_);
+			cache_.clear();
+			cache_order_.clear();
+		}
+
+		void Compression::SetMinSize(size_t bytes) {
+			min_size_ = bytes;
+		}
+
+		void Compression::SetContentTypes(const vector<string>& content_types) {
+			content_types_ = content_types;
+		}
+
+		void Compression::SetCacheCapacity(size_t entries) {
+			std::lock_guard<mutex> lock(cache_mutex_);
+			cache_capacity_ = entries;
+			cache_.clear();
+			cache_order_.clear();
+		}
+
+		Compression::Stats Compression::GetStats() const {
+			Stats stats;
+			stats.responses = responses_;
+			stats.cache_hits = cache_hits_;
+			stats.bytes_in = bytes_in_;
+			stats.bytes_out = bytes_out_;
+			stats.compress_ns = compress_ns_;
+			return stats;
+		}
+
+		bool Compression::IsBlocking() const {
+			return true;
+		}
+
+		int Compression::OnAfter(shared_ptr<Request> request, shared_ptr<Response> response) {
+			const string& payload = response->Payload();
+			int status_code = response->StatusCode();
+			if (response->IsStreaming() || payload.size() < min_size_ || status_code < 200 || status_code == 204 || status_code == 304)
+				return 0;
+			if (!response->Header("Content-Encoding").empty() || !IsCompressible(response->Header("Content-Type")))
+				return 0;
+			string vary = response->Header("Vary");
+			if (vary.empty()) {
+				response->SetHeader("Vary", "Accept-Encoding");
+			} else if (!ListsToken(vary, "Accept-Encoding")) {
+				response->SetHeader("Vary", vary + ", Accept-Encoding");
+			}
+			Encoding encoding = Negotiate(request->Header(KnownHeader::AcceptEncoding));
+			if (encoding == Encoding::Identity)
+				return 0;
+			bool gzip = encoding == Encoding::Gzip;
+			bool cacheable = response->IsCacheable() && cache_capacity_ > 0;
+			size_t key = cacheable ? std::hash<string>()(payload) * 31 + (gzip ? 1 : 2) : 0;
+			shared_ptr<const string> compressed = cacheable ? Lookup(key, payload) : nullptr;
+			shared_ptr<string> output;
+			if (compressed) {
+				cache_hits_++;
+			} else {
+				output = std::make_shared<string>();
+				if (0 != Compress(payload, gzip, *output))
+					return 0;
+				if (cacheable) {
+					Store(key, payload, output);
+				}
+				compressed = output;
+			}
+			// incompressible data is sent as is.
+			if (compressed->size() >= payload.size())
+				return 0;
+			responses_++;
+			bytes_in_ += payload.size();
+			bytes_out_ += compressed->size();
+			response->SetHeader("Content-Encoding", gzip ? "gzip" : "deflate");
+			// output the cache does not share moves into the response.
+			if (output && !cacheable) {
+				response->SetPayload(std::move(*output));
+			} else {
+				response->SetPayload(*compressed);
+			}
+			return 0;
+		}
+
+		bool Compression::IsCompressible(const string& content_type) const {
+			StringView media_type = StringView(content_type).substr(0, StringView(content_type).find(';')).Strip();
+			if (media_type.empty())
+				return false;
+			for (auto& allowed : content_types_) {
+				if (!allowed.empty() && allowed.back() == '/') {
+					if (media_type.size() > allowed.size() && media_type.substr(0, allowed.size()).EqualsIgnoreCase(allowed))
+						return true;
+				} else if (media_type.EqualsIgnoreCase(allowed)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		int Compression::Compress(const string& payload, bool gzip, string& compressed) {
+			auto start = std::chrono::steady_clock::now();
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+			// window bits 15 + 16 writes a gzip wrapper, plain 15 a zlib one.
+			if (Z_OK != deflateInit2(&stream, level_, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY))
+				return -1;
+			// deflateBound is enough for Z_FINISH to complete in a single call.
+			compressed.resize(deflateBound(&stream, (uLong)payload.size()));
+			stream.next_in = (Bytef*)payload.data();
+			stream.avail_in = (uInt)payload.size();
+			stream.next_out = (Bytef*)&compressed[0];
+			stream.avail_out = (uInt)compressed.size();
+			int retval = deflate(&stream, Z_FINISH);
+			compressed.resize(stream.total_out);
+			deflateEnd(&stream);
+			compress_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			return retval == Z_STREAM_END ? 0 : -1;
+		}
+
+		// a hash hit still compares the payload, so a collision is only a miss.
+		shared_ptr<const string> Compression::Lookup(size_t key, const string& payload) {
+			std::lock_guard<mutex> lock(cache_mutex_);
+			auto it = cache_.find(key);
+			if (it == cache_.end() || *it->second.payload != payload)
+				return nullptr;
+			cache_order_.splice(cache_order_.end(), cache_order_, it->second.order);
+			return it->second.compressed;
+		}
+
+		void Compression::Store(size_t key, const string& payload, shared_ptr<const string> compressed) {
+			std::lock_guard<mutex> lock(cache_mutex_);
+			if (0 == cache_capacity_)
+				return;
+			auto it = cache_.find(key);
+			if (it != cache_.end()) {
+				cache_order_.erase(it->second.order);
+				cache_.erase(it);
+			}
+			while (cache_.size() >= cache_capacity_ && !cache_order_.empty()) {
+				cache_.erase(cache_order_.front());
+				cache_order_.pop_front();
+			}
+			CacheEntry entry = { std::make_shared<string>(payload), compressed, cache_order_.insert(cache_order_.end(), key) };
+			cache_[key] = entry;
+		}
+	} // namespace http
+} // namespace moss
+
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "middleware.h"
+#include "moss_exports.h"
+
+
+using std::list;
+using std::mutex;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+namespace moss {
+	namespace http {
+		// gzip/deflate for payloads the client accepts. install it before other
+		// middleware so its OnAfter sees the final payload. it is blocking, so
+		// compression never runs on an io loop thread.
+		class Compression
+			: public Middleware {
+			struct CacheEntry {
+				shared_ptr<const string> payload;
+				shared_ptr<const string> compressed;
+				list<size_t>::iterator order;
+			};
+			using Cache = unordered_map<size_t, CacheEntry>;
+		public:
+			struct Stats {
+				uint64_t responses;
+				uint64_t cache_hits;
+				uint64_t bytes_in;
+				uint64_t bytes_out;
+				uint64_t compress_ns;
+			};
+
+			MOSS_EXPORT Compression(int level = 6);
+			MOSS_EXPORT void SetLevel(int level);
+			MOSS_EXPORT void SetMinSize(size_t bytes);
+			// media types (without parameters) eligible for compression, an entry
+			// ending in '/' matches the whole type, e.g. "text/".
+			MOSS_EXPORT void SetContentTypes(const vector<string>& content_types);
+			// compressed output of cacheable responses kept per payload, 0 disables.
+			MOSS_EXPORT void SetCacheCapacity(size_t entries);
+			MOSS_EXPORT Stats GetStats() const;
+			MOSS_EXPORT bool IsBlocking() const override;
+			MOSS_EXPORT int OnAfter(shared_ptr<Request> request, shared_ptr<Response> response) override;
+		private:
+			bool IsCompressible(const string& content_type) const;
+			int Compress(const string& payload, bool gzip, string& compressed);
+			shared_ptr<const string> Lookup(size_t key, const string& payload);
+			void Store(size_t key, const string& payload, shared_ptr<const string> compressed);
+			int level_;
+			size_t min_size_;
+			vector<string> content_types_;
+			size_t cache_capacity_;
+			mutable mutex cache_mutex_;
+			Cache cache_;
+			list<size_t> cache_order_;
+			std::atomic<uint64_t> responses_;
+			std::atomic<uint64_t> cache_hits_;
+			std::atomic<uint64_t> bytes_in_;
+			std::atomic<uint64_t> bytes_out_;
+			std::atomic<uint64_t> compress_ns_;
+		};
+	} // namespace http
+} // namespace moss
+
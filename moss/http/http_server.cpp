@@ -1,20 +1,73 @@
 #include "http_server.h"
 
 #include "application.h"
+#include "applications.h"
 #include "request.h"
 #include "response.h"
 #include "internal/http_server_impl.h"
 
 
 namespace moss {
-	HttpServer::HttpServer() {
+	HttpServer::HttpServer()
+		: applications_(std::make_shared<http::Applications>()),
+		keep_alive_timeout_(30),
+		max_keep_alive_requests_(1000),
+		max_pipelined_requests_(16),
+		io_workers_(1),
+		reuse_port_(false),
+		write_high_watermark_(1024 * 1024),
+		write_low_watermark_(256 * 1024),
+		timer_resolution_(100),
+		max_body_size_(0),
+		body_spill_threshold_(1024 * 1024),
+		server_name_("moss/1.0") {
 	}
 
 	int HttpServer::Install(shared_ptr<http::Application> application) {
 		if (!application)
 			return -1;
-		applications_[application->Name()] = application;
-		return 0;
+		return applications_->Install(application);
+	}
+
+	void HttpServer::SetKeepAliveTimeout(int seconds) {
+		keep_alive_timeout_ = seconds;
+	}
+
+	void HttpServer::SetMaxKeepAliveRequests(int max_requests) {
+		max_keep_alive_requests_ = max_requests;
+	}
+
+	void HttpServer::SetMaxPipelinedRequests(int max_requests) {
+		max_pipelined_requests_ = max_requests;
+	}
+
+	void HttpServer::SetIoWorkers(int io_workers) {
+		io_workers_ = io_workers;
+	}
+
+	void HttpServer::SetReusePort(bool reuse_port) {
+		reuse_port_ = reuse_port;
+	}
+
+	void HttpServer::SetWriteWatermarks(size_t high, size_t low) {
+		write_high_watermark_ = high;
+		write_low_watermark_ = low;
+	}
+
+	void HttpServer::SetTimerResolution(int milliseconds) {
+		timer_resolution_ = milliseconds;
+	}
+
+	void HttpServer::SetServerName(const string& server_name) {
+		server_name_ = server_name;
+	}
+
+	void HttpServer::SetMaxBodySize(size_t bytes) {
+		max_body_size_ = bytes;
+	}
+
+	void HttpServer::SetBodySpillThreshold(size_t bytes) {
+		body_spill_threshold_ = bytes;
 	}
 
 	int HttpServer::Start(const string& ip, int port, int workers/* = 10*/) {
@@ -26,30 +79,38 @@ namespace moss {
 		return impl_->Stop();
 	}
 
-	int HttpServer::Process(shared_ptr<http::Request> request, shared_ptr<http::Response> response) {
+	shared_ptr<http::Route> HttpServer::Find(shared_ptr<http::Request> request) {
+		unordered_map<string, string> args;
+		auto route = applications_->Find(request, args);
+		if (route) {
+			request->SetPathArgs(args);
+		}
+		return route;
+	}
+
+	// unrouted requests only get the default response, so they never need the pool.
+	bool HttpServer::IsInline(shared_ptr<http::Route> route) const {
+		if (!route)
+			return true;
+		auto application = route->CurrentApplication();
+		return application && application->IsInline(route);
+	}
+
+	int HttpServer::Process(shared_ptr<http::Route> route, shared_ptr<http::Request> request, shared_ptr<http::Response> response) {
 		shared_ptr<http::Application> application;
-		for (auto& it : applications_) {
-			int handled = it.second->Process(request, response);
-			if (handled < 0)
-				continue;
-			application = it.second;
-			break;
+		if (route) {
+			application = route->CurrentApplication();
 		}
-		auto connection_header = request->Header("Connection");
-		auto server_header = response->Header("Server");
-		if (server_header.empty()) {
-			if (application) {
-				response->SetHeader("Server", application->Name());
-			} else {
-				response->SetHeader("Server", "moss");
-			}
+		response->keep_alive_ = request->KeepAlive();
+		response->chunked_ = request->Version() >= 11;
+		response->head_ = request->Method() == "HEAD";
+		if (application) {
+			application->Process(route, request, response);
 		}
-		if (!connection_header.empty()) {
-			response->SetHeader("Connection", connection_header);
-		} else {
-			response->SetHeader("Connection", "close");
+		// a streaming response is finished by its producer through End().
+		if (!response->IsStreaming()) {
+			response->Send();
 		}
-		response->Send();
 		return 0;
 	}
 } // namespace moss
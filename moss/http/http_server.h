@@ -14,20 +14,54 @@ using std::string;
 using std::unordered_map;
 namespace moss {
 	class HttpServerImpl;
+	namespace http {
+		class Applications;
+	}
 	class HttpServer
 		: public std::enable_shared_from_this<HttpServer> {
-		using Applications = unordered_map<string, shared_ptr<http::Application>>;
 		friend class HttpServerImpl;
 	public:
 		MOSS_EXPORT HttpServer();
+		// one application per host and prefix, -1 when that pair is taken.
 		MOSS_EXPORT int Install(shared_ptr<http::Application> application);
+		MOSS_EXPORT void SetKeepAliveTimeout(int seconds);
+		MOSS_EXPORT void SetMaxKeepAliveRequests(int max_requests);
+		// pipelined requests in flight per connection, reading pauses at the
+		// limit until responses go out. 0 means no limit.
+		MOSS_EXPORT void SetMaxPipelinedRequests(int max_requests);
+		MOSS_EXPORT void SetIoWorkers(int io_workers);
+		// off by default: Start hands one listener to the io loops and blocks
+		// running it until Stop. on, each io loop listens with SO_REUSEPORT and
+		// Start returns as soon as all of them do.
+		MOSS_EXPORT void SetReusePort(bool reuse_port);
+		MOSS_EXPORT void SetWriteWatermarks(size_t high, size_t low);
+		MOSS_EXPORT void SetTimerResolution(int milliseconds);
+		// value of the Server header every response carries, empty leaves it out.
+		MOSS_EXPORT void SetServerName(const string& server_name);
+		// requests declaring or sending a larger body get 413, 0 means no limit.
+		MOSS_EXPORT void SetMaxBodySize(size_t bytes);
+		// buffered bodies past this size move to a temporary file, 0 never spills.
+		MOSS_EXPORT void SetBodySpillThreshold(size_t bytes);
 		MOSS_EXPORT int Start(const string& ip, int port, int workers = 10);
 		MOSS_EXPORT int Stop();
 	protected:
-		int Process(shared_ptr<http::Request> request, shared_ptr<http::Response> response);
+		shared_ptr<http::Route> Find(shared_ptr<http::Request> request);
+		bool IsInline(shared_ptr<http::Route> route) const;
+		int Process(shared_ptr<http::Route> route, shared_ptr<http::Request> request, shared_ptr<http::Response> response);
 	private:
 		shared_ptr<HttpServerImpl> impl_;
-		Applications applications_;
+		shared_ptr<http::Applications> applications_;
+		int keep_alive_timeout_;
+		int max_keep_alive_requests_;
+		int max_pipelined_requests_;
+		int io_workers_;
+		bool reuse_port_;
+		size_t write_high_watermark_;
+		size_t write_low_watermark_;
+		int timer_resolution_;
+		size_t max_body_size_;
+		size_t body_spill_threshold_;
+		string server_name_;
 	};
 } // namespace moss
 
@@ -9,44 +9,27 @@
 #include "../../tcp/tcp_server.h"
 #include "utils/logger.h"
 #include "utils/task.h"
-#include "utils/timer.h"
 #include "utils/string_helper.h"
 
 
 namespace moss {
 	namespace {
-		class RequestTimeoutChecker
-			: public moss::Task {
-		public:
-			RequestTimeoutChecker(shared_ptr<HttpServerImpl> server)
-				: server_(server) {
-			}
-
-			void Run() override {
-				auto server = server_.lock();
-				if (server) {
-					server->CheckRequestTimeout();
-				}
-			}
-		private:
-			weak_ptr<HttpServerImpl> server_;
-		};
-
 		class RequestHandler
 			: public moss::Task {
 		public:
-			RequestHandler(shared_ptr<HttpServerImpl> server, shared_ptr<http::Request> request, shared_ptr<http::Response> response)
-				: server_(server), request_(request), response_(response) {
+			RequestHandler(shared_ptr<HttpServerImpl> server, shared_ptr<http::Route> route, shared_ptr<http::Request> request, shared_ptr<http::Response> response)
+				: server_(server), route_(route), request_(request), response_(response) {
 			}
 
 			void Run() override {
 				auto server = server_.lock();
 				if (server) {
-					server->Process(request_, response_);
+					server->Process(route_, request_, response_);
 				}
 			}
 		private:
 			weak_ptr<HttpServerImpl> server_;
+			shared_ptr<http::Route> route_;
 			shared_ptr<http::Request> request_;
 			shared_ptr<http::Response> response_;
 		};
@@ -55,20 +38,44 @@ namespace moss {
 	HttpServerImpl::HttpServerImpl(weak_ptr<HttpServer> context)
 		: context_(context),
 		session_id_seq_(0),
-		mutex_(std::make_shared<mutex>()),
 		read_timeout_(15),
-		write_timeout_(30) {
+		write_timeout_(30),
+		keep_alive_timeout_(30),
+		max_keep_alive_requests_(0),
+		max_pipelined_requests_(0),
+		io_workers_(1),
+		reuse_port_(false),
+		write_high_watermark_(0),
+		write_low_watermark_(0),
+		timer_resolution_(100),
+		max_body_size_(0),
+		body_spill_threshold_(0),
+		server_name_("moss/1.0") {
 	}
 
 	int HttpServerImpl::Start(const string& ip, int port, int workers) {
+		auto context = context_.lock();
+		if (context) {
+			keep_alive_timeout_ = context->keep_alive_timeout_;
+			max_keep_alive_requests_ = context->max_keep_alive_requests_;
+			max_pipelined_requests_ = context->max_pipelined_requests_;
+			io_workers_ = context->io_workers_;
+			reuse_port_ = context->reuse_port_;
+			write_high_watermark_ = context->write_high_watermark_;
+			write_low_watermark_ = context->write_low_watermark_;
+			timer_resolution_ = context->timer_resolution_;
+			server_name_ = context->server_name_;
+			max_body_size_ = context->max_body_size_;
+			body_spill_threshold_ = context->body_spill_threshold_;
+		}
+		header_blocks_.resize(io_workers_ > 0 ? io_workers_ : 1);
 		server_ = std::make_shared<TcpServer>(shared_from_this());
 		task_runner_ = std::make_shared<TaskRunner>();
-		timer_loop_ = std::make_shared<TimerLoop>();
 		task_runner_->Start(workers);
-		timer_loop_->Start();
-		auto timer = std::make_shared<Timer>(std::chrono::seconds(1));
-		timer->Start(std::make_shared<RequestTimeoutChecker>(shared_from_this()));
-		return server_->Start(ip, port);
+		server_->SetReusePort(reuse_port_);
+		server_->SetWriteWatermarks(write_high_watermark_, write_low_watermark_);
+		server_->SetTimerResolution(timer_resolution_);
+		return server_->Start(ip, port, io_workers_);
 	}
 
 	int HttpServerImpl::Stop() {
@@ -78,23 +85,25 @@ namespace moss {
 	int HttpServerImpl::OnCreate(shared_ptr<Connection> connection) {
 		auto session = std::make_shared<http::Session>(session_id_seq_.fetch_add(1), connection, shared_from_this());
 		session->CreateParser();
+		session->SetWriteHighWatermark(write_high_watermark_);
 		connection->SetUserContext(session);
-		std::lock_guard<mutex> lock(*mutex_);
-		sessions_[session->Id()] = session;
+		connection->SetTimeout(read_timeout_ * 1000);
 		return 0;
 	}
 
-	int HttpServerImpl::OnRead(shared_ptr<Connection> connection, shared_ptr<string> rdbuf, int size) {
+	int HttpServerImpl::OnRead(shared_ptr<Connection> connection, const char* data, size_t size) {
 		auto session = std::static_pointer_cast<http::Session>(connection->UserContext());
-		if (!session)
+		auto context = context_.lock();
+		if (!session || !context)
 			return -1;
-		session->LastRead((int64_t)time(nullptr));
-		auto request = session->Append(rdbuf, size);
-		if (request) {
-			session->ReadComplete();
-			session->ResetParser();
-			auto response = std::make_shared<http::Response>(session);
-			task_runner_->Push(std::make_shared<RequestHandler>(shared_from_this(), request, response));
+		if (session->IsReadStopped() || session->HasError())
+			return 0;
+		// while responses are outstanding the write timeout runs, reads do not extend it.
+		bool writing = session->IsReadCompleted();
+		session->Append(data, size);
+		Dispatch(session, connection);
+		if (!writing) {
+			UpdateTimeout(session, connection);
 		}
 		return 0;
 	}
@@ -103,8 +112,14 @@ namespace moss {
 		auto session = std::static_pointer_cast<http::Session>(connection->UserContext());
 		if (!session)
 			return -1;
-		session->LastWrite((int64_t)time(nullptr));
-		session->Close();
+		// a failed write leaves the response cut short, the connection can not go on.
+		if (0 != status || session->IsLastWrite(wrbuf)) {
+			session->Close();
+		} else {
+			session->WriteComplete();
+			Dispatch(session, connection);
+			UpdateTimeout(session, connection);
+		}
 		return 0;
 	}
 
@@ -112,11 +127,7 @@ namespace moss {
 		auto session = std::static_pointer_cast<http::Session>(connection->UserContext());
 		if (!session)
 			return -1;
-		std::lock_guard<mutex> lock(*mutex_);
-		auto it = sessions_.find(session->Id());
-		if (it != sessions_.end()) {
-			sessions_.erase(it);
-		}
+		session->NotifyClosed();
 		return 0;
 	}
 
@@ -125,48 +136,118 @@ namespace moss {
 		return 0;
 	}
 
-	int HttpServerImpl::CheckRequestTimeout() {
-		Sessions sessions;
-		{
-			std::lock_guard<mutex> lock(*mutex_);
-			sessions = sessions_;
+	int HttpServerImpl::OnTimeout(shared_ptr<Connection> connection) {
+		auto session = std::static_pointer_cast<http::Session>(connection->UserContext());
+		if (!session)
+			return -1;
+		session->Close();
+		return 0;
+	}
+
+	int HttpServerImpl::OnWritability(shared_ptr<Connection> connection, bool writable) {
+		auto session = std::static_pointer_cast<http::Session>(connection->UserContext());
+		if (!session)
+			return -1;
+		session->SetWritable(writable);
+		return 0;
+	}
+
+	int HttpServerImpl::OnTick(int loop_id) {
+		if (loop_id < 0 || loop_id >= (int)header_blocks_.size())
+			return -1;
+		header_blocks_[loop_id] = http::Response::RenderHeaderBlock(time(nullptr), server_name_);
+		return 0;
+	}
+
+	shared_ptr<const string> HttpServerImpl::HeaderBlock(int loop_id) const {
+		if (loop_id < 0 || loop_id >= (int)header_blocks_.size())
+			return nullptr;
+		return header_blocks_[loop_id];
+	}
+
+	// loop thread: one deadline per connection, chosen by the session state.
+	void HttpServerImpl::UpdateTimeout(shared_ptr<http::Session> session, shared_ptr<Connection> connection) {
+		if (session->IsClosing())
+			return;
+		time_t timeout = read_timeout_;
+		if (session->IsReadCompleted()) {
+			timeout = write_timeout_;
+		} else if (session->IsIdle()) {
+			timeout = keep_alive_timeout_;
 		}
-		time_t now = time(nullptr);
-		for (auto& it : sessions) {
-			auto session = it.second;
-			if (!session || session->IsClosing())
-				continue;
-			bool timeout = false;
-			if (!session->IsReadCompleted()) {
-				if (now - session->LastRead() > read_timeout_) {
-					timeout = true;
-				}
+		connection->SetTimeout((int64_t)timeout * 1000);
+	}
+
+	// loop thread: hands parsed requests to their routes in order, at most
+	// max_pipelined_requests_ with their responses outstanding. reading pauses
+	// while requests wait for that, or while the responses queued behind the
+	// head one are over the write high watermark; OnWrite dispatches the rest.
+	void HttpServerImpl::Dispatch(shared_ptr<http::Session> session, shared_ptr<Connection> connection) {
+		auto context = context_.lock();
+		if (!context)
+			return;
+		auto header_block = HeaderBlock(connection->LoopId());
+		while (!session->IsReadStopped() && !session->IsClosing()) {
+			if (max_pipelined_requests_ > 0 && session->PendingResponses() >= max_pipelined_requests_)
+				break;
+			auto request = session->PopRequest();
+			if (!request)
+				break;
+			session->ReadComplete();
+			auto response = std::make_shared<http::Response>(session, session->NextSequence());
+			response->header_block_ = header_block;
+			auto route = request->route_;
+			if (context->IsInline(route)) {
+				context->Process(route, request, response);
 			} else {
-				if (now - session->LastWrite() > write_timeout_) {
-					timeout = true;
-				}
+				task_runner_->Push(std::make_shared<RequestHandler>(shared_from_this(), route, request, response));
 			}
-			if (timeout) {
-				session->Close();
+			if (!request->KeepAlive()) {
+				session->StopRead();
 			}
 		}
-		return 0;
+		// a parse error is answered after the requests parsed before it.
+		if (!session->IsReadStopped() && session->HasError() && !session->HasRequest()) {
+			session->StopRead();
+			session->ReadComplete();
+			auto response = std::make_shared<http::Response>(session, session->NextSequence());
+			response->header_block_ = header_block;
+			response->SetStatusCode(session->ErrorStatus());
+			response->SetHeader("Connection", "close");
+			response->Send();
+		}
+		bool held = session->HasRequest() || (write_high_watermark_ > 0 && session->PendingBytes() > write_high_watermark_);
+		connection->SetReadPaused(held && !session->IsReadStopped());
 	}
 
-	int HttpServerImpl::Process(shared_ptr<http::Request> request, shared_ptr<http::Response> response) {
+	// loop thread, once the headers of a request are in: resolves the route
+	// and applies the body limits. returns the status to reject it with, or 0.
+	// the keep-alive limit applies here so the parser knows to stop after it.
+	int HttpServerImpl::RouteRequest(shared_ptr<http::Session> session, shared_ptr<http::Request> request) {
 		auto context = context_.lock();
-		return context->Process(request, response);
+		if (!context)
+			return 0;
+		int count = session->IncreaseRequests();
+		if (max_keep_alive_requests_ > 0 && count >= max_keep_alive_requests_) {
+			request->SetKeepAlive(false);
+		}
+		request->route_ = context->Find(request);
+		request->max_body_size_ = max_body_size_;
+		request->body_spill_threshold_ = body_spill_threshold_;
+		return request->ReserveBody(request->ContentLength());
+	}
+
+	int HttpServerImpl::Process(shared_ptr<http::Route> route, shared_ptr<http::Request> request, shared_ptr<http::Response> response) {
+		auto context = context_.lock();
+		if (!context)
+			return -1;
+		return context->Process(route, request, response);
 	}
 
 	int HttpServerImpl::CloseSession(shared_ptr<http::Session> session) {
 		if (!session)
 			return -1;
 		session->Close();
-		std::lock_guard<mutex> lock(*mutex_);
-		auto it = sessions_.find(session->Id());
-		if (it != sessions_.end()) {
-			sessions_.erase(it);
-		}
 		return 0;
 	}
 } // namespace moss
@@ -1,6 +1,9 @@
 #include "request_parser.h"
 
+#include <mutex>
+#include "session.h"
 #include "../request.h"
+#include "../route.h"
 #include "third_party/http_parser/http_parser.h"
 
 
@@ -23,84 +26,122 @@ namespace moss {
 				return nullptr;
 			}
 
+			// a non-zero status stops the parser, the session answers with it.
+			static int fail(http_parser* parser, int status) {
+				if (0 == status)
+					return 0;
+				auto request_parser = get_request_parser(parser);
+				if (request_parser && 0 == request_parser->error_status_) {
+					request_parser->error_status_ = status;
+				}
+				return -1;
+			}
+
+			// callbacks may deliver any field in several fragments, the request
+			// stitches consecutive fragments of the same field together.
 			static int on_url(http_parser* parser, const char* at, size_t length) {
 				auto request = get_current_request(parser);
-				request->SetUrl(string(at, length));
-				return 0;
+				return fail(parser, request->AppendUrl(at, length));
 			}
 
+			// routed before any of the body arrives, so body streaming and the
+			// size limit apply from the first byte.
 			static int on_headers_complete(http_parser* parser) {
-				return 0;
+				auto request_parser = get_request_parser(parser);
+				auto request = request_parser->GetRequest();
+				request->method_ = http_method_str((http_method)parser->method);
+				request->SetKeepAlive(0 != http_should_keep_alive(parser));
+				request->version_ = parser->http_major * 10 + parser->http_minor;
+				request->CompleteHeaders();
+				return fail(parser, request_parser->RouteRequest());
 			}
 
 			static int on_body(http_parser* parser, const char* at, size_t length) {
 				auto request = get_current_request(parser);
-				request->SetBody(string(at, length));
-				return 0;
+				int status = request->AppendBody(at, length);
+				if (0 == status && request->IsBodyStreaming() && 0 != request->route_->OnBody(request, at, length)) {
+					status = 400;
+				}
+				return fail(parser, status);
 			}
 
 			static int on_header_field(http_parser* parser, const char* at, size_t length) {
 				RequestParserContext* p = reinterpret_cast<RequestParserContext*>(parser->data);
-				p->current_header_ = string(at, length);
-				return 0;
+				auto request = get_current_request(parser);
+				int status = request->AppendHeaderField(at, length, !p->in_header_field_);
+				p->in_header_field_ = true;
+				return fail(parser, status);
 			}
 
 			static int on_header_value(http_parser* parser, const char* at, size_t length) {
 				RequestParserContext* p = reinterpret_cast<RequestParserContext*>(parser->data);
 				auto request = get_current_request(parser);
-				request->SetHeader(p->current_header_, string(at, length));
-				return 0;
+				int status = request->AppendHeaderValue(at, length);
+				p->in_header_field_ = false;
+				return fail(parser, status);
 			}
 
 			static int on_message_begin(http_parser* parser) {
+				RequestParserContext* p = reinterpret_cast<RequestParserContext*>(parser->data);
 				auto request_parser = get_request_parser(parser);
 				request_parser->PrepareRequest();
-				auto request = request_parser->GetRequest();
-				request->SetMethod(http_method_str((http_method)parser->method));
+				p->in_header_field_ = false;
 				return 0;
 			}
 
+			// nothing after a request that closes the connection gets parsed, let
+			// alone routed: the parser stays paused until it is reset.
 			static int on_message_complete(http_parser* parser) {
 				auto request_parser = get_request_parser(parser);
+				auto request = request_parser->GetRequest();
 				request_parser->CompleteRequest();
+				if (request && !request->KeepAlive()) {
+					http_parser_pause(parser, 1);
+				}
 				return 0;
 			}
 
+			// content_length holds the size of the chunk that follows.
 			static int on_chunk_header(http_parser* parser) {
-				auto request_parser = get_current_request(parser);
-				return 0;
+				auto request = get_current_request(parser);
+				return fail(parser, request->ReserveBody(parser->content_length));
 			}
-
-			static int on_chunk_complete(http_parser* parser) {
-				auto request_parser = get_current_request(parser);
-				return 0;
+			static const http_parser_settings* get_settings() {
+				static http_parser_settings settings;
+				static std::once_flag settings_initialized;
+				std::call_once(settings_initialized, []() {
+					http_parser_settings_init(&settings);
+					settings.on_message_begin = on_message_begin;
+					settings.on_url = on_url;
+					settings.on_header_field = on_header_field;
+					settings.on_header_value = on_header_value;
+					settings.on_headers_complete = on_headers_complete;
+					settings.on_body = on_body;
+					settings.on_message_complete = on_message_complete;
+					settings.on_chunk_header = on_chunk_header;
+				});
+				return &settings;
 			}
 		public:
 			RequestParserContext(shared_ptr<RequestParser> request_parser)
 				: request_parser_(request_parser),
-				settings_(std::make_shared<http_parser_settings>()),
-				parser_(std::make_shared<http_parser>()) {
-				http_parser_settings_init(settings_.get());
-				settings_->on_message_begin = on_message_begin;
-				settings_->on_url = on_url;
-				settings_->on_header_field = on_header_field;
-				settings_->on_header_value = on_header_value;
-				settings_->on_headers_complete = on_headers_complete;
-				settings_->on_body = on_body;
-				settings_->on_message_complete = on_message_complete;
-				settings_->on_chunk_header = on_chunk_header;
-				settings_->on_chunk_complete = on_chunk_complete;
-				http_parser_init(parser_.get(), HTTP_REQUEST);
-				parser_->data = this;
+				in_header_field_(false) {
+				http_parser_init(&parser_, HTTP_REQUEST);
+				parser_.data = this;
 			}
 
 			void Reset() {
-				http_parser_init(parser_.get(), HTTP_REQUEST);
-				parser_->data = this;
+				http_parser_init(&parser_, HTTP_REQUEST);
+				parser_.data = this;
 			}
 
 			size_t Parse(const char* data, size_t len) {
-				return http_parser_execute(parser_.get(), settings_.get(), data, len);
+				return http_parser_execute(&parser_, get_settings(), data, len);
+			}
+
+			bool HasError() const {
+				auto error = HTTP_PARSER_ERRNO(&parser_);
+				return HPE_OK != error && HPE_PAUSED != error;
 			}
 
 			shared_ptr<RequestParser> GetRequestParser() {
@@ -108,15 +149,15 @@ namespace moss {
 			}
 		private:
 			weak_ptr<RequestParser> request_parser_;
-			shared_ptr<http_parser_settings> settings_;
-			shared_ptr<http_parser> parser_;
-			string current_header_;
+			http_parser parser_;
+			bool in_header_field_;
 		};
 
 		RequestParser::RequestParser(shared_ptr<Session> session)
 			: session_(session),
-			request_(std::make_shared<Request>(session)),
-			request_completed_(false) {
+			request_completed_(false),
+			parsing_(false),
+			error_status_(0) {
 		}
 
 		void RequestParser::Initalize() {
@@ -125,28 +166,65 @@ namespace moss {
 
 		void RequestParser::Reset() {
 			context_->Reset();
+			request_.reset();
+			parsing_ = false;
 		}
 
 		size_t RequestParser::Parse(const char* data, size_t len) {
 			return context_->Parse(data, len);
 		}
 
+		bool RequestParser::HasError() const {
+			return context_->HasError();
+		}
+
+		int RequestParser::ErrorStatus() const {
+			return error_status_ > 0 ? error_status_ : 400;
+		}
+
+		int RequestParser::RouteRequest() {
+			auto session = session_.lock();
+			if (!session)
+				return 0;
+			return session->RouteRequest(request_);
+		}
+
 		void RequestParser::PrepareRequest() {
 			request_completed_ = false;
+			parsing_ = true;
 			request_ = std::make_shared<Request>(session_.lock());
 		}
 
 		void RequestParser::CompleteRequest() {
 			request_completed_ = true;
+			parsing_ = false;
+			completed_requests_.push_back(request_);
+			request_.reset();
 		}
 
 		bool RequestParser::IsRequestCompleted() const {
 			return request_completed_;
 		}
 
+		bool RequestParser::IsParsing() const {
+			return parsing_;
+		}
+
 		shared_ptr<Request> RequestParser::GetRequest() {
 			return request_;
 		}
+
+		shared_ptr<Request> RequestParser::PopRequest() {
+			if (completed_requests_.empty())
+				return nullptr;
+			auto request = completed_requests_.front();
+			completed_requests_.pop_front();
+			return request;
+		}
+
+		bool RequestParser::HasRequest() const {
+			return !completed_requests_.empty();
+		}
 	} // namespace http
 } // namespace moss
 
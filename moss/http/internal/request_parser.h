@@ -1,9 +1,11 @@
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <string>
 
 
+using std::deque;
 using std::shared_ptr;
 using std::string;
 using std::weak_ptr;
@@ -20,15 +22,25 @@ namespace moss {
 			void Initalize();
 			void Reset();
 			size_t Parse(const char* data, size_t len);
+			bool HasError() const;
+			int ErrorStatus() const;
 			void PrepareRequest();
+			int RouteRequest();
 			void CompleteRequest();
 			bool IsRequestCompleted() const;
+			bool IsParsing() const;
+			// null between messages, a completed request only lives in the queue.
 			shared_ptr<Request> GetRequest();
+			shared_ptr<Request> PopRequest();
+			bool HasRequest() const;
 		private:
 			weak_ptr<Session> session_;
 			shared_ptr<RequestParserContext> context_;
 			shared_ptr<Request> request_;
+			deque<shared_ptr<Request>> completed_requests_;
 			bool request_completed_;
+			bool parsing_;
+			int error_status_;
 		};
 	} // namespace http
 } // namespace moss
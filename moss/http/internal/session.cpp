@@ -1,5 +1,6 @@
 #include "session.h"
 
+#include "http_server_impl.h"
 #include "request_parser.h"
 #include "../../tcp/connection.h"
 #include "utils/logger.h"
@@ -13,10 +14,18 @@ namespace moss {
 			server_(server),
 			ip_(connection->Ip()),
 			closing_(false),
-			read_completed_(false),
-			last_read_(0),
-			last_write_(0) {
-			ResetTimeout();
+			read_stopped_(false),
+			idle_(false),
+			requests_(0),
+			outstanding_(0),
+			next_sequence_(0),
+			mutex_(std::make_shared<mutex>()),
+			next_write_(0),
+			pending_bytes_(0),
+			write_high_watermark_(0),
+			writable_mutex_(std::make_shared<mutex>()),
+			writable_(true) {
+			UpdateIdle();
 		}
 
 		Session::~Session() {
@@ -35,46 +44,100 @@ namespace moss {
 		}
 
 		void Session::Close() {
-			closing_ = true;
+			NotifyClosed();
 			auto connection = connection_.lock();
 			if (connection) {
 				connection->Close();
 			}
 		}
 
+		void Session::NotifyClosed() {
+			std::lock_guard<mutex> lock(*writable_mutex_);
+			closing_ = true;
+			writable_cond_.notify_all();
+		}
+
 		bool Session::IsClosing() const {
 			return closing_;
 		}
 
+		// separate from mutex_, writability changes while Write holds that lock.
+		void Session::SetWritable(bool writable) {
+			std::lock_guard<mutex> lock(*writable_mutex_);
+			writable_ = writable;
+			writable_cond_.notify_all();
+		}
+
+		void Session::SetWriteHighWatermark(size_t bytes) {
+			write_high_watermark_ = bytes;
+		}
+
+		// blocks a producer thread until the connection drains below the low
+		// watermark. the producer of a response behind the head one instead
+		// waits while what is queued behind the head is over the high watermark.
+		// the loop thread can not wait for its own writes, there it only tells
+		// whether the producer may go on. false once the session is closing.
+		bool Session::WaitWritable(int64_t sequence) {
+			auto connection = connection_.lock();
+			if (!connection)
+				return false;
+			std::unique_lock<mutex> lock(*writable_mutex_);
+			if (connection->IsLoopThread())
+				return !closing_ && CanWrite(sequence);
+			writable_cond_.wait(lock, [this, sequence]() {
+				return closing_ || CanWrite(sequence);
+			});
+			return !closing_;
+		}
+
+		// under writable_mutex_.
+		bool Session::CanWrite(int64_t sequence) const {
+			if (sequence != next_write_)
+				return 0 == write_high_watermark_ || pending_bytes_ <= write_high_watermark_;
+			return writable_;
+		}
+
 		void Session::ReadComplete() {
-			read_completed_ = true;
+			outstanding_++;
 		}
 
 		bool Session::IsReadCompleted() const {
-			return read_completed_;
+			return outstanding_ > 0;
+		}
+
+		void Session::WriteComplete() {
+			if (--outstanding_ <= 0) {
+				outstanding_ = 0;
+				UpdateIdle();
+			}
 		}
 
-		void Session::LastRead(int64_t last_read) {
-			last_read_ = last_read;
+		void Session::StopRead() {
+			read_stopped_ = true;
 		}
 
-		int64_t Session::LastRead() const {
-			return last_read_;
+		bool Session::IsReadStopped() const {
+			return read_stopped_;
 		}
 
-		void Session::LastWrite(int64_t last_write) {
-			last_write_ = last_write;
+		bool Session::IsIdle() const {
+			return idle_;
 		}
 
-		int64_t Session::LastWrite() const {
-			return last_write_;
+		int Session::IncreaseRequests() {
+			return ++requests_;
 		}
 
-		void Session::ResetTimeout() {
-			auto now = time(nullptr);
-			last_read_ = now;
-			last_write_ = now;
-			read_completed_ = false;
+		int Session::Requests() const {
+			return requests_;
+		}
+
+		int64_t Session::NextSequence() {
+			return next_sequence_++;
+		}
+
+		void Session::UpdateIdle() {
+			idle_ = (requests_ > 0) && !(request_parser_ && request_parser_->IsParsing());
 		}
 
 		int Session::CreateParser() {
@@ -91,23 +154,99 @@ namespace moss {
 			}
 		}
 
-		shared_ptr<Request> Session::Append(shared_ptr<string> rdbuf, size_t size) {
-			if (size < 0)
-				return nullptr;
-			request_parser_->Parse(rdbuf->data(), (size_t)size);
-			if (!request_parser_->IsRequestCompleted()) {
-				return nullptr;
-			}
-			return request_parser_->GetRequest();
+		int Session::Append(const char* data, size_t size) {
+			idle_ = false;
+			request_parser_->Parse(data, size);
+			return request_parser_->HasError() ? -1 : 0;
 		}
 
-		int Session::Write(shared_ptr<string> wrbuf) {
+		shared_ptr<Request> Session::PopRequest() {
+			return request_parser_->PopRequest();
+		}
+
+		bool Session::HasRequest() const {
+			return request_parser_->HasRequest();
+		}
+
+		bool Session::HasError() const {
+			return request_parser_->HasError();
+		}
+
+		int Session::ErrorStatus() const {
+			return request_parser_ ? request_parser_->ErrorStatus() : 400;
+		}
+
+		int Session::RouteRequest(shared_ptr<Request> request) {
+			auto server = server_.lock();
+			if (!server)
+				return 0;
+			return server->RouteRequest(shared_from_this(), request);
+		}
+
+		// segments of the response at the head go out as they arrive, later
+		// responses wait in pending_writes_ until the ones before are complete.
+		int Session::Write(int64_t sequence, shared_ptr<string> wrbuf, bool keep_alive, bool complete/* = true*/) {
 			auto connection = connection_.lock();
-			if (connection) {
-				connection->Write(wrbuf);
+			if (!connection)
+				return -1;
+			std::lock_guard<mutex> lock(*mutex_);
+			if (sequence < next_write_ || last_wrbuf_)
+				return -1;
+			auto& pending_write = pending_writes_[sequence];
+			if (pending_write.complete)
+				return -1;
+			pending_write.wrbufs.push_back(wrbuf);
+			pending_write.keep_alive = keep_alive;
+			pending_write.complete = complete;
+			if (!complete) {
+				// every segment reports OnWrite, only the last one ends the response.
+				outstanding_++;
+			}
+			if (sequence != next_write_) {
+				pending_bytes_ += wrbuf->size();
+				return 0;
+			}
+			int64_t head = next_write_;
+			for (auto it = pending_writes_.begin(); it != pending_writes_.end() && it->first == next_write_; it = pending_writes_.erase(it)) {
+				shared_ptr<string> last_segment;
+				for (auto& segment : it->second.wrbufs) {
+					connection->Write(segment);
+					if (it->first != sequence) {
+						pending_bytes_ -= segment->size();
+					}
+					last_segment = segment;
+				}
+				it->second.wrbufs.clear();
+				if (!it->second.complete)
+					break;
+				next_write_++;
+				if (!it->second.keep_alive) {
+					last_wrbuf_ = last_segment;
+					pending_writes_.clear();
+					pending_bytes_ = 0;
+					break;
+				}
+			}
+			// producers behind the old head may go on, or are the head now.
+			if (head != next_write_ && write_high_watermark_ > 0) {
+				std::lock_guard<mutex> writable_lock(*writable_mutex_);
+				writable_cond_.notify_all();
 			}
 			return 0;
 		}
+
+		bool Session::IsLastWrite(shared_ptr<string> wrbuf) const {
+			std::lock_guard<mutex> lock(*mutex_);
+			return last_wrbuf_ && last_wrbuf_ == wrbuf;
+		}
+
+		int64_t Session::PendingResponses() const {
+			return next_sequence_ - next_write_;
+		}
+
+		size_t Session::PendingBytes() const {
+			return pending_bytes_;
+		}
 	} // namespace http
 } // namespace moss
 
@@ -1,13 +1,20 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <ctime>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 
+using std::map;
+using std::mutex;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 using std::weak_ptr;
 namespace moss {
 	class Connection;
@@ -18,6 +25,13 @@ namespace moss {
 		class Session
 			: public std::enable_shared_from_this<Session> {
 			friend class HttpServer;
+			// a response is written as one or more segments, it is done once complete.
+			struct PendingWrite {
+				vector<shared_ptr<string>> wrbufs;
+				bool keep_alive;
+				bool complete;
+			};
+			using PendingWrites = map<int64_t, PendingWrite>;
 		public:
 			Session(int64_t id, shared_ptr<Connection> connection, shared_ptr<HttpServerImpl> server);
 			~Session();
@@ -25,30 +39,59 @@ namespace moss {
 			string Ip() const;
 			shared_ptr<Connection> GetConnection() const;
 			void Close();
+			void NotifyClosed();
 			bool IsClosing() const;
+			void SetWritable(bool writable);
+			void SetWriteHighWatermark(size_t bytes);
+			bool WaitWritable(int64_t sequence);
 			void ReadComplete();
 			bool IsReadCompleted() const;
-			void LastRead(int64_t last_read);
-			int64_t LastRead() const;
-			void LastWrite(int64_t last_write);
-			int64_t LastWrite() const;
-			void ResetTimeout();
+			void WriteComplete();
+			void StopRead();
+			bool IsReadStopped() const;
+			bool IsIdle() const;
+			int IncreaseRequests();
+			int Requests() const;
+			int64_t NextSequence();
+			void UpdateIdle();
 			int CreateParser();
 			void ResetParser();
-			shared_ptr<Request> Append(shared_ptr<string> rdbuf, size_t size);
-			int Write(shared_ptr<string> wrbuf);
+			int Append(const char* data, size_t size);
+			// parsed requests wait here until dispatched, oldest first.
+			shared_ptr<Request> PopRequest();
+			bool HasRequest() const;
+			bool HasError() const;
+			int ErrorStatus() const;
+			int RouteRequest(shared_ptr<Request> request);
+			int Write(int64_t sequence, shared_ptr<string> wrbuf, bool keep_alive, bool complete = true);
+			bool IsLastWrite(shared_ptr<string> wrbuf) const;
+			// dispatched requests whose responses are not handed to the connection yet.
+			int64_t PendingResponses() const;
+			size_t PendingBytes() const;
 		private:
+			bool CanWrite(int64_t sequence) const;
 			int64_t id_;
 			weak_ptr<Connection> connection_;
 			weak_ptr<HttpServerImpl> server_;
 			string ip_;
 			shared_ptr<RequestParser> request_parser_;
 			std::atomic_bool closing_;
-			std::atomic_bool read_completed_;
-			std::atomic_int64_t last_read_;
-			std::atomic_int64_t last_write_;
+			std::atomic_bool read_stopped_;
+			std::atomic_bool idle_;
+			std::atomic_int requests_;
+			std::atomic_int outstanding_;
+			int64_t next_sequence_;
+			shared_ptr<mutex> mutex_;
+			std::atomic<int64_t> next_write_;
+			PendingWrites pending_writes_;
+			// bytes of later responses waiting in pending_writes_ for the head one.
+			std::atomic<size_t> pending_bytes_;
+			size_t write_high_watermark_;
+			shared_ptr<string> last_wrbuf_;
+			shared_ptr<mutex> writable_mutex_;
+			std::condition_variable writable_cond_;
+			bool writable_;
 		};
 	}
 } // namespace moss
 
-
@@ -0,0 +1,89 @@
+#include "known_header.h"
+
+
+namespace moss {
+	namespace http {
+		namespace {
+			const char* known_header_names[kKnownHeaderCount] = {
+				"Accept",
+				"Accept-Encoding",
+				"Accept-Language",
+				"Authorization",
+				"Cache-Control",
+				"Connection",
+				"Content-Encoding",
+				"Content-Length",
+				"Content-Type",
+				"Cookie",
+				"Date",
+				"Expect",
+				"Host",
+				"If-Modified-Since",
+				"If-None-Match",
+				"Origin",
+				"Referer",
+				"Transfer-Encoding",
+				"Upgrade",
+				"User-Agent",
+				"X-Forwarded-For",
+				"X-Forwarded-Host",
+				"X-Forwarded-Proto",
+				"X-Real-IP",
+				"X-Schema"
+			};
+		}
+
+		uint32_t HeaderNameHash(const StringView& name) {
+			uint32_t hash = 2166136261u;
+			for (char ch : name) {
+				hash = (hash ^ (uint8_t)HeaderNameLower(ch)) * 16777619u;
+			}
+			return hash;
+		}
+
+		// the switch also guarantees at compile time that no two names collide.
+		KnownHeader FindKnownHeader(const StringView& name) {
+			KnownHeader header;
+			switch (HeaderNameHash(name)) {
+			case HeaderNameHash("accept"): header = KnownHeader::Accept; break;
+			case HeaderNameHash("accept-encoding"): header = KnownHeader::AcceptEncoding; break;
+			case HeaderNameHash("accept-language"): header = KnownHeader::AcceptLanguage; break;
+			case HeaderNameHash("authorization"): header = KnownHeader::Authorization; break;
+			case HeaderNameHash("cache-control"): header = KnownHeader::CacheControl; break;
+			case HeaderNameHash("connection"): header = KnownHeader::Connection; break;
+			case HeaderNameHash("content-encoding"): header = KnownHeader::ContentEncoding; break;
+			case HeaderNameHash("content-length"): header = KnownHeader::ContentLength; break;
+			case HeaderNameHash("content-type"): header = KnownHeader::ContentType; break;
+			case HeaderNameHash("cookie"): header = KnownHeader::Cookie; break;
+			case HeaderNameHash("date"): header = KnownHeader::Date; break;
+			case HeaderNameHash("expect"): header = KnownHeader::Expect; break;
+			case HeaderNameHash("host"): header = KnownHeader::Host; break;
+			case HeaderNameHash("if-modified-since"): header = KnownHeader::IfModifiedSince; break;
+			case HeaderNameHash("if-none-match"): header = KnownHeader::IfNoneMatch; break;
+			case HeaderNameHash("origin"): header = KnownHeader::Origin; break;
+			case HeaderNameHash("referer"): header = KnownHeader::Referer; break;
+			case HeaderNameHash("transfer-encoding"): header = KnownHeader::TransferEncoding; break;
+			case HeaderNameHash("upgrade"): header = KnownHeader::Upgrade; break;
+			case HeaderNameHash("user-agent"): header = KnownHeader::UserAgent; break;
+			case HeaderNameHash("x-forwarded-for"): header = KnownHeader::XForwardedFor; break;
+			case HeaderNameHash("x-forwarded-host"): header = KnownHeader::XForwardedHost; break;
+			case HeaderNameHash("x-forwarded-proto"): header = KnownHeader::XForwardedProto; break;
+			case HeaderNameHash("x-real-ip"): header = KnownHeader::XRealIp; break;
+			case HeaderNameHash("x-schema"): header = KnownHeader::XSchema; break;
+			default:
+				return KnownHeader::Unknown;
+			}
+			// a hash hit on an unknown name must not alias a known slot.
+			if (!name.EqualsIgnoreCase(known_header_names[(int)header]))
+				return KnownHeader::Unknown;
+			return header;
+		}
+
+		const char* KnownHeaderName(KnownHeader header) {
+			if (header >= KnownHeader::Count)
+				return "";
+			return known_header_names[(int)header];
+		}
+	} // namespace http
+} // namespace moss
+
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include "utils/string_view.h"
+#include "moss_exports.h"
+
+
+namespace moss {
+	namespace http {
+		enum class KnownHeader {
+			Accept,
+			AcceptEncoding,
+			AcceptLanguage,
+			Authorization,
+			CacheControl,
+			Connection,
+			ContentEncoding,
+			ContentLength,
+			ContentType,
+			Cookie,
+			Date,
+			Expect,
+			Host,
+			IfModifiedSince,
+			IfNoneMatch,
+			Origin,
+			Referer,
+			TransferEncoding,
+			Upgrade,
+			UserAgent,
+			XForwardedFor,
+			XForwardedHost,
+			XForwardedProto,
+			XRealIp,
+			XSchema,
+			Count,
+			Unknown = Count
+		};
+
+		const int kKnownHeaderCount = (int)KnownHeader::Count;
+
+		// FNV-1a over the lowercased name, usable in constant expressions.
+		constexpr char HeaderNameLower(char ch) {
+			return (ch >= 'A' && ch <= 'Z') ? (char)(ch + ('a' - 'A')) : ch;
+		}
+
+		constexpr uint32_t HeaderNameHash(const char* name, uint32_t hash = 2166136261u) {
+			return *name ? HeaderNameHash(name + 1, (hash ^ (uint8_t)HeaderNameLower(*name)) * 16777619u) : hash;
+		}
+
+		MOSS_EXPORT uint32_t HeaderNameHash(const StringView& name);
+		MOSS_EXPORT KnownHeader FindKnownHeader(const StringView& name);
+		MOSS_EXPORT const char* KnownHeaderName(KnownHeader header);
+	} // namespace http
+} // namespace moss
+
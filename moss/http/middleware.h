@@ -13,28 +13,24 @@ namespace moss {
 		class Application;
 		class Request;
 		class Response;
-		class Route;
 
+		// OnBefore runs in install order, a negative result skips the rest of the
+		// chain and the route. OnAfter runs in reverse for every middleware whose
+		// OnBefore succeeded.
 		class Middleware {
 			friend class Application;
-			enum class Stage {
-				Before,
-				After
-			};
 		public:
 			MOSS_EXPORT Middleware(const string& name);
 			MOSS_EXPORT virtual ~Middleware();
 			MOSS_EXPORT string Name() const;
 			shared_ptr<Application> CurrentApplication() const;
 			void AttachApplication(shared_ptr<Application> application);
-			void Append(shared_ptr<Middleware> middleware);
+			// a blocking middleware keeps the routes whose chain includes it off the io loop.
+			MOSS_EXPORT virtual bool IsBlocking() const;
 			MOSS_EXPORT virtual int OnBefore(shared_ptr<moss::http::Request> request, shared_ptr<moss::http::Response> response);
 			MOSS_EXPORT virtual int OnAfter(shared_ptr<moss::http::Request> request, shared_ptr<moss::http::Response> response);
 		protected:
-			int Process(shared_ptr<Request> request, shared_ptr<Response> response, Stage stage);
-			int Process(shared_ptr<Route> route, shared_ptr<Request> request, shared_ptr<Response> response);
 			weak_ptr<Application> application_;
-			shared_ptr<Middleware> sibling_;
 			string name_;
 		};
 	} // namespace http
@@ -0,0 +1,132 @@
+#include "path_pattern.h"
+
+
+namespace moss {
+	namespace http {
+		namespace {
+			// capturing groups opened by a regex fragment, skipping escapes,
+			// bracket expressions and (?...) groups.
+			size_t CountGroups(const string& expression) {
+				size_t groups = 0;
+				bool in_class = false;
+				for (size_t i = 0; i < expression.size(); i++) {
+					char ch = expression[i];
+					if (ch == '\\') {
+						i++;
+					} else if (in_class) {
+						in_class = ch != ']';
+					} else if (ch == '[') {
+						in_class = true;
+					} else if (ch == '(' && (i + 1 >= expression.size() || expression[i + 1] != '?')) {
+						groups++;
+					}
+				}
+				return groups;
+			}
+		}
+
+		PathPattern::PathPattern()
+			: engine_(PatternEngine::Nfa) {
+		}
+
+		int PathPattern::Compile(const string& pattern, PatternEngine engine, string& error) {
+			string expr;
+			keys_.clear();
+			size_t groups = 0;
+			int bare = 0;
+			bool in_class = false;
+			for (size_t i = 0; i < pattern.length(); i++) {
+				char ch = pattern.at(i);
+				if (ch == '\\' && i + 1 < pattern.length()) {
+					expr.append(pattern, i, 2);
+					i++;
+					continue;
+				}
+				// a bracket expression is plain regex: "[(]" opens no group, "[{]" no param.
+				if (in_class || ch == '[') {
+					in_class = !in_class || ch != ']';
+					expr.append(1, ch);
+					continue;
+				}
+				if (ch == '{') {
+					size_t j = i + 1, colon = string::npos, depth = 0;
+					for (; j < pattern.length(); j++) {
+						if (pattern[j] == '{') {
+							depth++;
+						} else if (pattern[j] == '}') {
+							if (0 == depth)
+								break;
+							depth--;
+						} else if (pattern[j] == ':' && colon == string::npos) {
+							colon = j;
+						}
+					}
+					if (j >= pattern.length()) {
+						error = "unbalanced '{' in " + pattern;
+						return -1;
+					}
+					if (colon == string::npos) {
+						keys_.push_back(std::make_pair(pattern.substr(i + 1, j - i - 1), ++groups));
+						expr.append("([^/\\?]+)");
+					} else {
+						string value = pattern.substr(colon + 1, j - colon - 1);
+						keys_.push_back(std::make_pair(pattern.substr(i + 1, colon - i - 1), ++groups));
+						groups += CountGroups(value);
+						expr.append("(" + value + ")");
+					}
+					i = j;
+					continue;
+				}
+				if (ch == '(' && (i + 1 >= pattern.length() || pattern[i + 1] != '?')) {
+					keys_.push_back(std::make_pair("g" + std::to_string(++bare), ++groups));
+				}
+				expr.append(1, ch);
+			}
+			if (0 != CompileExpression(expr, engine, error)) {
+				error = pattern + ": " + error;
+				return -1;
+			}
+			return 0;
+		}
+
+		int PathPattern::CompileExpression(const string& expression, PatternEngine engine, string& error) {
+			engine_ = engine == PatternEngine::Regex ? PatternEngine::Regex : PatternEngine::Nfa;
+			if (engine_ == PatternEngine::Nfa)
+				return nfa_.Compile(expression, error);
+			try {
+				regex_ = std::regex(expression);
+			} catch (const std::regex_error& e) {
+				error = e.what();
+				return -1;
+			}
+			return 0;
+		}
+
+		bool PathPattern::Match(const StringView& path, unordered_map<string, string>& args) const {
+			if (engine_ == PatternEngine::Nfa) {
+				static thread_local vector<const char*> captures;
+				if (!nfa_.Match(path.begin(), path.end(), &captures))
+					return false;
+				for (auto& key : keys_) {
+					const char* begin = captures[key.second * 2];
+					args[key.first] = begin ? string(begin, captures[key.second * 2 + 1]) : string();
+				}
+				return true;
+			}
+			std::cmatch mr;
+			if (!std::regex_match(path.begin(), path.end(), mr, regex_))
+				return false;
+			for (auto& key : keys_) {
+				args[key.first] = mr[key.second].str();
+			}
+			return true;
+		}
+
+		bool PathPattern::Match(const StringView& path) const {
+			if (engine_ == PatternEngine::Nfa)
+				return nfa_.Match(path.begin(), path.end());
+			return std::regex_match(path.begin(), path.end(), regex_);
+		}
+	} // namespace http
+} // namespace moss
+
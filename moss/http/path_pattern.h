@@ -0,0 +1,40 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "route.h"
+#include "utils/nfa_regex.h"
+#include "utils/string_view.h"
+
+
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+namespace moss {
+	namespace http {
+		// a "~" route pattern translated to a regex once: {name} matches one
+		// segment, {name:regex} matches regex, a bare (group) is captured as gN.
+		class PathPattern {
+		public:
+			PathPattern();
+			// -1 for unbalanced braces or an expression the engine rejects, the
+			// message in error. Default means Nfa.
+			int Compile(const string& pattern, PatternEngine engine, string& error);
+			// a plain regex without {name} translation or captures.
+			int CompileExpression(const string& expression, PatternEngine engine, string& error);
+			bool Match(const StringView& path, unordered_map<string, string>& args) const;
+			bool Match(const StringView& path) const;
+		private:
+			PatternEngine engine_;
+			NfaRegex nfa_;
+			std::regex regex_;
+			// capture name and the regex group it reads from.
+			vector<pair<string, size_t>> keys_;
+		};
+	} // namespace http
+} // namespace moss
+
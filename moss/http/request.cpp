@@ -1,16 +1,48 @@
 #include "request.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include "route.h"
 #include "internal/session.h"
-#include "utils/string_helper.h"
 #include "utils/url.h"
+#include "third_party/http_parser/http_parser.h"
 
 
 namespace moss {
 	namespace http {
+		namespace {
+			// yields the next "name=value" pair of a Cookie header, pairs without '=' are skipped.
+			bool NextCookie(const StringView& cookie, size_t& pos, StringView& name, StringView& value) {
+				while (pos < cookie.size()) {
+					size_t end = cookie.find(';', pos);
+					if (end == StringView::npos) {
+						end = cookie.size();
+					}
+					StringView pair = cookie.substr(pos, end - pos);
+					pos = end + 1;
+					size_t assign = pair.find('=');
+					if (assign == StringView::npos)
+						continue;
+					name = pair.substr(0, assign).Strip();
+					value = pair.substr(assign + 1).Strip();
+					if (!name.empty())
+						return true;
+				}
+				return false;
+			}
+		}
+
 		Request::Request(shared_ptr<Session> session)
-			: session_(session) {
+			: session_(session),
+			body_size_(0),
+			max_body_size_(0),
+			body_spill_threshold_(0),
+			keep_alive_(false),
+			version_(11),
+			queries_parsed_(false) {
+			headers_.reserve(16);
 		}
 
 		shared_ptr<Session> Request::GetSession() const {
@@ -18,29 +50,150 @@ namespace moss {
 		}
 
 		void Request::SetMethod(const string& method) {
-			method_ = method;
+			method_ = arena_.Copy(method.data(), method.size());
 		}
 
 		void Request::SetUrl(const string& url) {
-			url_ = std::make_shared<moss::Url>(url);
+			url_raw_ = arena_.Copy(url.data(), url.size());
+			ParseUrl();
 		}
 
 		void Request::SetHeader(const string& key, const string& value) {
-			string header = String(key).ToLower().str();
-			headers_[header] = value;
-			if (header == "cookie") {
-				cookies_ = String(value).split(";", "=");
-			} else if (header == "host" || header == "x-forwarded-host") {
-				url_->Set("host", value);
-			} else if (header == "x-schema" || header == "x-forwarded-proto") {
-				url_->Set("schema", value);
-			} else if (header == "x-real-ip") {
-				ip_ = value;
+			StringView header_value = arena_.Copy(value.data(), value.size());
+			KnownHeader header = FindKnownHeader(key);
+			if (header != KnownHeader::Unknown) {
+				known_headers_[(int)header] = header_value;
+				ApplyHeader(header, header_value);
+				return;
+			}
+			for (auto& entry : headers_) {
+				if (entry.name.EqualsIgnoreCase(key)) {
+					entry.value = header_value;
+					return;
+				}
 			}
+			headers_.push_back(HeaderEntry{ arena_.Copy(key.data(), key.size()), header_value });
 		}
 
 		void Request::SetBody(const string& body) {
-			body_ += body;
+			AppendBody(body.data(), body.size());
+		}
+
+		// parser fragments are stitched in the arena, a value split across two
+		// reads ends up contiguous just like one that arrived in a single read.
+		// like AppendBody they return 0 or the status to reject the request with.
+		int Request::AppendUrl(const char* data, size_t size) {
+			StringView url = arena_.Append(url_raw_, data, size);
+			if (!url.data())
+				return 500;
+			url_raw_ = url;
+			return 0;
+		}
+
+		int Request::AppendHeaderField(const char* data, size_t size, bool new_header) {
+			if (new_header) {
+				CommitHeader();
+			}
+			StringView name = new_header ? arena_.Copy(data, size) : arena_.Append(pending_header_.name, data, size);
+			if (!name.data())
+				return 500;
+			pending_header_.name = name;
+			return 0;
+		}
+
+		int Request::AppendHeaderValue(const char* data, size_t size) {
+			StringView value = arena_.Append(pending_header_.value, data, size);
+			if (!value.data())
+				return 500;
+			pending_header_.value = value;
+			return 0;
+		}
+
+		// returns 0 or the http status the request has to be rejected with.
+		int Request::AppendBody(const char* data, size_t size) {
+			int status = ReserveBody(size);
+			if (0 != status)
+				return status;
+			body_size_ += size;
+			if (IsBodyStreaming())
+				return 0;
+			if (!body_file_ && body_spill_threshold_ > 0 && body_size_ > body_spill_threshold_) {
+				if (0 != SpillBody())
+					return 500;
+			}
+			if (body_file_) {
+				return size == fwrite(data, 1, size, body_file_.get()) ? 0 : 500;
+			}
+			StringView body = arena_.Append(body_, data, size);
+			if (!body.data())
+				return 500;
+			body_ = body;
+			return 0;
+		}
+
+		int Request::ReserveBody(uint64_t size) const {
+			if (max_body_size_ > 0 && size > max_body_size_ - body_size_)
+				return 413;
+			return 0;
+		}
+
+		int Request::SpillBody() {
+			FILE* file = tmpfile();
+			if (!file)
+				return -1;
+			body_file_.reset(file, fclose);
+			if (!body_.empty() && body_.size() != fwrite(body_.data(), 1, body_.size(), file))
+				return -1;
+			body_ = StringView();
+			return 0;
+		}
+
+		bool Request::IsBodyStreaming() const {
+			return route_ && route_->IsBodyStreaming();
+		}
+
+		// a header is only classified once its name is complete. it applies in
+		// arrival order, of Host and X-Forwarded-Host the one sent last wins.
+		void Request::CommitHeader() {
+			if (pending_header_.name.empty())
+				return;
+			KnownHeader header = FindKnownHeader(pending_header_.name);
+			if (header != KnownHeader::Unknown) {
+				known_headers_[(int)header] = pending_header_.value;
+				if (!pending_header_.value.empty()) {
+					ApplyHeader(header, pending_header_.value);
+				}
+			} else {
+				headers_.push_back(pending_header_);
+			}
+			pending_header_ = HeaderEntry();
+		}
+
+		void Request::CompleteHeaders() {
+			CommitHeader();
+			ParseUrl();
+		}
+
+		void Request::ApplyHeader(KnownHeader header, const StringView& value) {
+			switch (header) {
+			case KnownHeader::Host:
+			case KnownHeader::XForwardedHost:
+				forwarded_host_ = value;
+				break;
+			case KnownHeader::XSchema:
+			case KnownHeader::XForwardedProto:
+				forwarded_schema_ = value;
+				break;
+			case KnownHeader::XRealIp:
+				ip_ = value;
+				break;
+			default:
+				break;
+			}
+		}
+
+		void Request::SetKeepAlive(bool keep_alive) {
+			keep_alive_ = keep_alive;
 		}
 
 		string Request::Ip() const {
@@ -51,49 +204,207 @@ namespace moss {
 			return session->Ip();
 		}
 
-		string Request::Method() const {
+		StringView Request::Method() const {
 			return method_;
 		}
 
+		StringView Request::Host() const {
+			return forwarded_host_.empty() ? host_ : forwarded_host_;
+		}
+
 		string Request::Url() const {
-			return url_->Make();
+			StringView schema = forwarded_schema_.empty() ? schema_ : forwarded_schema_;
+			StringView host = forwarded_host_.empty() ? host_ : forwarded_host_;
+			string url;
+			url.reserve(url_raw_.size() + schema.size() + host.size() + 4);
+			if (!schema.empty()) {
+				url.append(schema.data(), schema.size()).append("://");
+			}
+			if (!user_info_.empty()) {
+				url.append(user_info_.data(), user_info_.size()).append("@");
+			}
+			url.append(host.data(), host.size());
+			if (!port_.empty()) {
+				url.append(":").append(port_.data(), port_.size());
+			}
+			StringView path = Path();
+			url.append(path.data(), path.size());
+			if (!query_.empty()) {
+				url.append("?").append(query_.data(), query_.size());
+			}
+			if (!fragment_.empty()) {
+				url.append("#").append(fragment_.data(), fragment_.size());
+			}
+			return url;
 		}
 
-		string Request::Path() const {
-			return url_->Path();
+		StringView Request::Path() const {
+			if (path_.empty())
+				return StringView("/", 1);
+			return path_;
 		}
 
-		string Request::Query(const string& key) const {
-			return url_->Query(key);
+		// the query string is only split on the first lookup.
+		StringView Request::Query(const StringView& key) const {
+			if (!queries_parsed_) {
+				ParseQueries();
+			}
+			for (auto it = queries_.rbegin(); it != queries_.rend(); ++it) {
+				if (it->key == key) {
+					return it->value;
+				}
+			}
+			return StringView();
+		}
+
+		void Request::ParseUrl() {
+			StringView* fields[UF_MAX] = { nullptr };
+			fields[UF_SCHEMA] = &schema_;
+			fields[UF_HOST] = &host_;
+			fields[UF_PORT] = &port_;
+			fields[UF_PATH] = &path_;
+			fields[UF_QUERY] = &query_;
+			fields[UF_FRAGMENT] = &fragment_;
+			fields[UF_USERINFO] = &user_info_;
+			for (auto field : fields) {
+				if (field) {
+					*field = StringView();
+				}
+			}
+			queries_parsed_ = false;
+			queries_.clear();
+			if (url_raw_.empty())
+				return;
+			http_parser_url parser;
+			http_parser_url_init(&parser);
+			if (0 != http_parser_parse_url(url_raw_.data(), url_raw_.size(), 0, &parser))
+				return;
+			for (int i = 0; i < UF_MAX; i++) {
+				if (fields[i] && (parser.field_set & (1 << i))) {
+					*fields[i] = url_raw_.substr(parser.field_data[i].off, parser.field_data[i].len);
+				}
+			}
+		}
+
+		void Request::ParseQueries() const {
+			queries_parsed_ = true;
+			size_t pos = 0;
+			while (pos < query_.size()) {
+				size_t end = query_.find('&', pos);
+				if (end == StringView::npos) {
+					end = query_.size();
+				}
+				StringView pair = query_.substr(pos, end - pos);
+				pos = end + 1;
+				if (pair.empty())
+					continue;
+				size_t assign = pair.find('=');
+				StringView key = pair.substr(0, assign);
+				StringView value = assign == StringView::npos ? StringView() : pair.substr(assign + 1);
+				if (value.find('%') != StringView::npos) {
+					string decoded = moss::Url::Decode(value);
+					value = arena_.Copy(decoded.data(), decoded.size());
+				}
+				queries_.push_back(QueryEntry{ key, value });
+			}
 		}
 
 		string Request::Header(const string& key) const {
-			auto it = headers_.find(String(key).ToLower());
-			if (it != headers_.end()) {
-				return it->second;
+			KnownHeader header = FindKnownHeader(key);
+			if (header != KnownHeader::Unknown)
+				return known_headers_[(int)header];
+			for (auto it = headers_.rbegin(); it != headers_.rend(); ++it) {
+				if (it->name.EqualsIgnoreCase(key)) {
+					return it->value;
+				}
 			}
 			return string();
 		}
 
+		StringView Request::Header(KnownHeader header) const {
+			if (header >= KnownHeader::Count)
+				return StringView();
+			return known_headers_[(int)header];
+		}
+
 		string Request::Body() const {
-			return body_;
+			if (!body_file_)
+				return body_;
+			string body(BodySize(), '\0');
+			body.resize(ReadBody(0, &body[0], body.size()));
+			return body;
 		}
 
-		string Request::Cookie(const string& key) const {
-			auto it = cookies_.find(key);
-			if (it != cookies_.end()) {
-				return it->second;
+		size_t Request::BodySize() const {
+			return body_file_ ? body_size_ : body_.size();
+		}
+
+		size_t Request::ReadBody(size_t offset, char* data, size_t size) const {
+			if (offset >= BodySize())
+				return 0;
+			size = std::min(size, BodySize() - offset);
+			if (!body_file_) {
+				memcpy(data, body_.data() + offset, size);
+				return size;
 			}
-			return string();
+#ifdef _WIN32
+			if (0 != _fseeki64(body_file_.get(), (int64_t)offset, SEEK_SET))
+				return 0;
+#else
+			if (0 != fseeko(body_file_.get(), (off_t)offset, SEEK_SET))
+				return 0;
+#endif
+			return fread(data, 1, size, body_file_.get());
+		}
+
+		bool Request::IsBodySpilled() const {
+			return !!body_file_;
+		}
+
+		// scans the raw header in place, the other cookies are never copied.
+		StringView Request::Cookie(const StringView& key) const {
+			StringView cookie = Header(KnownHeader::Cookie);
+			StringView name, value;
+			size_t pos = 0;
+			while (NextCookie(cookie, pos, name, value)) {
+				if (name == key) {
+					return value;
+				}
+			}
+			return StringView();
+		}
+
+		unordered_map<string, string> Request::Cookies() const {
+			unordered_map<string, string> cookies;
+			StringView cookie = Header(KnownHeader::Cookie);
+			StringView name, value;
+			size_t pos = 0;
+			while (NextCookie(cookie, pos, name, value)) {
+				cookies.insert(std::make_pair(name.str(), value.str()));
+			}
+			return cookies;
 		}
 
 		string Request::ContentType() const {
-			return Header("Content-Type");
+			return Header(KnownHeader::ContentType);
 		}
 
 		size_t Request::ContentLength() const {
-			string content_length = Header("Content-Length");
-			return std::strtoul(content_length.c_str(), nullptr, 10);
+			size_t content_length = 0;
+			for (char ch : Header(KnownHeader::ContentLength).Strip()) {
+				if (ch < '0' || ch > '9')
+					break;
+				content_length = content_length * 10 + (ch - '0');
+			}
+			return content_length;
+		}
+
+		bool Request::KeepAlive() const {
+			return keep_alive_;
+		}
+
+		int Request::Version() const {
+			return version_;
 		}
 
 		void Request::SetUserContext(shared_ptr<void> user_context) {
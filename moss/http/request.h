@@ -1,24 +1,42 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include "utils/arena.h"
+#include "utils/string_view.h"
+#include "known_header.h"
 #include "moss_exports.h"
 
 
 using std::shared_ptr;
 using std::string;
 using std::unordered_map;
+using std::vector;
 using std::weak_ptr;
 namespace moss {
-	class Url;
+	class HttpServerImpl;
 	namespace http {
+		class Route;
 		class Session;
+		class RequestParserContext;
 		class Request {
-			using Headers = unordered_map<string, string>;
-			using Cookies = unordered_map<string, string>;
+			friend class RequestParserContext;
+			friend class moss::HttpServerImpl;
+			struct HeaderEntry {
+				StringView name;
+				StringView value;
+			};
+			using Headers = vector<HeaderEntry>;
 			using PathArgs = unordered_map<string, string>;
+			struct QueryEntry {
+				StringView key;
+				StringView value;
+			};
+			using Queries = vector<QueryEntry>;
 		public:
 			MOSS_EXPORT Request(shared_ptr<Session> session);
 			MOSS_EXPORT shared_ptr<Session> GetSession() const;
@@ -26,29 +44,77 @@ namespace moss {
 			MOSS_EXPORT void SetUrl(const string& url);
 			MOSS_EXPORT void SetHeader(const string& key, const string& value);
 			MOSS_EXPORT void SetBody(const string& body);
+			MOSS_EXPORT void SetKeepAlive(bool keep_alive);
 			MOSS_EXPORT string Ip() const;
-			MOSS_EXPORT string Method() const;
+			MOSS_EXPORT StringView Method() const;
 			MOSS_EXPORT string Url() const;
-			MOSS_EXPORT string Path() const;
-			MOSS_EXPORT string Query(const string& key) const;
+			// the later of Host / X-Forwarded-Host, else the host of an absolute request url.
+			MOSS_EXPORT StringView Host() const;
+			MOSS_EXPORT StringView Path() const;
+			MOSS_EXPORT StringView Query(const StringView& key) const;
 			MOSS_EXPORT string Header(const string& key) const;
+			MOSS_EXPORT StringView Header(KnownHeader header) const;
+			// bodies past the spill threshold live in a temporary file, Body()
+			// reads it back whole, ReadBody reads a range of either kind.
 			MOSS_EXPORT string Body() const;
-			MOSS_EXPORT string Cookie(const string& key) const;
+			MOSS_EXPORT size_t BodySize() const;
+			MOSS_EXPORT size_t ReadBody(size_t offset, char* data, size_t size) const;
+			MOSS_EXPORT bool IsBodySpilled() const;
+			MOSS_EXPORT StringView Cookie(const StringView& key) const;
+			MOSS_EXPORT unordered_map<string, string> Cookies() const;
 			MOSS_EXPORT string ContentType() const;
 			MOSS_EXPORT size_t ContentLength() const;
+			MOSS_EXPORT bool KeepAlive() const;
+			// 11 for HTTP/1.1, 10 for HTTP/1.0.
+			MOSS_EXPORT int Version() const;
 			MOSS_EXPORT void SetUserContext(shared_ptr<void> user_context);
 			MOSS_EXPORT shared_ptr<void> UserContext();
 			MOSS_EXPORT shared_ptr<void> UserContext() const;
 			MOSS_EXPORT void SetPathArgs(PathArgs& args);
 			MOSS_EXPORT string Path(const string& key);
 		private:
+			int AppendUrl(const char* data, size_t size);
+			int AppendHeaderField(const char* data, size_t size, bool new_header);
+			int AppendHeaderValue(const char* data, size_t size);
+			int AppendBody(const char* data, size_t size);
+			int ReserveBody(uint64_t size) const;
+			int SpillBody();
+			bool IsBodyStreaming() const;
+			void ParseUrl();
+			void ParseQueries() const;
+			void CommitHeader();
+			void CompleteHeaders();
+			void ApplyHeader(KnownHeader header, const StringView& value);
+			// method, url, headers and body live in arena_ and go away with the request.
+			mutable Arena arena_;
 			weak_ptr<Session> session_;
-			string method_;
-			string body_;
+			StringView method_;
+			StringView url_raw_;
+			// url components are views into url_raw_, filled from http_parser_url offsets.
+			StringView schema_;
+			StringView user_info_;
+			StringView host_;
+			StringView port_;
+			StringView path_;
+			StringView query_;
+			StringView fragment_;
+			StringView forwarded_schema_;
+			StringView forwarded_host_;
+			StringView body_;
+			shared_ptr<FILE> body_file_;
+			size_t body_size_;
+			size_t max_body_size_;
+			size_t body_spill_threshold_;
+			shared_ptr<Route> route_;
 			string ip_;
-			shared_ptr<moss::Url> url_;
+			bool keep_alive_;
+			int version_;
+			mutable bool queries_parsed_;
+			mutable Queries queries_;
+			// known headers sit in fixed slots, anything else in the flat headers_.
+			StringView known_headers_[kKnownHeaderCount];
 			Headers headers_;
-			Cookies cookies_;
+			HeaderEntry pending_header_;
 			shared_ptr<void> user_context_;
 			PathArgs path_args_;
 		};
@@ -1,41 +1,301 @@
 #include "response.h"
 
-#include <ctime>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
 #include "third_party/http_parser/http_parser.h"
 #include "internal/session.h"
+#include "utils/string_view.h"
 
 
-using std::ostringstream;
 namespace moss {
 	namespace http {
-		std::ostream& operator<<(std::ostream& stream, const Response& response) {
-			stream << "HTTP/1.1 " << response.status_code_ << " " << http_status_str(http_status(response.status_code_)) << "\r\n";
-			for (auto it = response.headers_.begin(); it != response.headers_.end(); ++it) {
-				stream << it->first << ": " << it->second << "\r\n";
+		namespace {
+			const int kMinStatusCode = 100;
+			const int kMaxStatusCode = 599;
+			// "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+			const size_t kDateHeaderSize = 37;
+
+			// "HTTP/1.1 200 OK\r\n" for every code in [100, 599], built once.
+			const vector<string>& StatusLines() {
+				static const vector<string> status_lines = []() {
+					vector<string> lines;
+					lines.reserve(kMaxStatusCode - kMinStatusCode + 1);
+					for (int code = kMinStatusCode; code <= kMaxStatusCode; code++) {
+						lines.push_back("HTTP/1.1 " + std::to_string(code) + " " + http_status_str(http_status(code)) + "\r\n");
+					}
+					return lines;
+				}();
+				return status_lines;
 			}
-			for (auto it = response.cookies_.begin(); it != response.cookies_.end(); ++it) {
-				stream << "Set-Cookie: " << it->first << "=" << it->second << "\r\n";
+
+			size_t FormatSize(size_t value, char* buffer) {
+				char digits[24];
+				size_t length = 0;
+				do {
+					digits[length++] = (char)('0' + value % 10);
+					value /= 10;
+				} while (value > 0);
+				for (size_t i = 0; i < length; i++) {
+					buffer[i] = digits[length - i - 1];
+				}
+				return length;
+			}
+
+			// the low width digits of value, zero padded, returns the end.
+			char* FormatDigits(int value, int width, char* buffer) {
+				for (int i = width - 1; i >= 0; i--) {
+					buffer[i] = (char)('0' + value % 10);
+					value /= 10;
+				}
+				return buffer + width;
 			}
-			stream << "\r\n";
-			stream << response.payload_;
+		}
+
+		std::ostream& operator<<(std::ostream& stream, const Response& response) {
+			auto wrbuf = response.Serialize();
+			stream.write(wrbuf->data(), wrbuf->size());
 			return stream;
 		}
 
 		int Response::Send() {
 			auto session = session_.lock();
-			if (!session) {
+			if (!session || streaming_) {
 				return -1;
 			}
-			ostringstream oss;
-			oss << *this;
-			auto wrbuf = std::make_shared<string>(std::move(oss.str()));
-			return session->Write(wrbuf);
+			UpdateKeepAlive();
+			return session->Write(sequence_, Serialize(), keep_alive_);
+		}
+
+		int Response::StatusCode() const {
+			return status_code_;
+		}
+
+		const string& Response::Payload() const {
+			return payload_;
+		}
+
+		void Response::SetCacheable(bool cacheable) {
+			cacheable_ = cacheable;
+		}
+
+		bool Response::IsCacheable() const {
+			return cacheable_;
+		}
+
+		int Response::BeginStream() {
+			auto session = session_.lock();
+			if (!session || streaming_) {
+				return -1;
+			}
+			streaming_ = true;
+			RemoveHeader("Content-Length");
+			if (chunked_) {
+				SetHeader("Transfer-Encoding", "chunked");
+			} else {
+				keep_alive_ = false;
+			}
+			UpdateKeepAlive();
+			string payload = std::move(payload_);
+			payload_.clear();
+			int retval = session->Write(sequence_, Serialize(), keep_alive_, false);
+			if (0 == retval && !payload.empty()) {
+				retval = Write(payload);
+			}
+			return retval;
+		}
+
+		int Response::Write(const char* data, size_t size) {
+			if (!streaming_ || ended_)
+				return -1;
+			if (0 == size || head_)
+				return 0;
+			auto session = session_.lock();
+			if (!session || !session->WaitWritable(sequence_))
+				return -1;
+			if (!chunked_)
+				return session->Write(sequence_, std::make_shared<string>(data, size), keep_alive_, false);
+			char size_line[24];
+			int length = snprintf(size_line, sizeof(size_line), "%zx\r\n", size);
+			auto wrbuf = std::make_shared<string>();
+			wrbuf->reserve(length + size + 2);
+			wrbuf->append(size_line, length).append(data, size).append("\r\n");
+			return session->Write(sequence_, wrbuf, keep_alive_, false);
+		}
+
+		int Response::Write(const string& chunk) {
+			return Write(chunk.data(), chunk.size());
+		}
+
+		int Response::End() {
+			if (!streaming_ || ended_)
+				return -1;
+			ended_ = true;
+			auto session = session_.lock();
+			if (!session)
+				return -1;
+			return session->Write(sequence_, std::make_shared<string>(chunked_ && !head_ ? "0\r\n\r\n" : ""), keep_alive_);
+		}
+
+		bool Response::IsStreaming() const {
+			return streaming_;
+		}
+
+		// an honoured "Connection: close" from the handler ends keep-alive.
+		void Response::UpdateKeepAlive() {
+			if (keep_alive_ && StringView("close").EqualsIgnoreCase(Header("Connection"))) {
+				keep_alive_ = false;
+			}
+			SetHeader("Connection", keep_alive_ ? "keep-alive" : "close");
+		}
+
+		size_t Response::SerializedSize() const {
+			size_t size = 0;
+			if (status_code_ >= kMinStatusCode && status_code_ <= kMaxStatusCode) {
+				size += StatusLines()[status_code_ - kMinStatusCode].size();
+			} else {
+				size += 9 + std::to_string(status_code_).size() + 1 + strlen(http_status_str(http_status(status_code_))) + 2;
+			}
+			size += HeaderBlockSize();
+			for (auto& header : headers_) {
+				size += header.first.size() + 2 + header.second.size() + 2;
+			}
+			if (NeedsContentLength()) {
+				char digits[24];
+				size += 16 + FormatSize(payload_.size(), digits) + 2;
+			}
+			for (auto& cookie : cookies_) {
+				size += 12 + cookie.first.size() + 1 + cookie.second.size() + 2;
+			}
+			return size + 2 + (HasBody() && !head_ ? payload_.size() : 0);
+		}
+
+		// sized up front so the whole response is written into a single allocation.
+		shared_ptr<string> Response::Serialize() const {
+			auto wrbuf = std::make_shared<string>();
+			wrbuf->reserve(SerializedSize());
+			if (status_code_ >= kMinStatusCode && status_code_ <= kMaxStatusCode) {
+				wrbuf->append(StatusLines()[status_code_ - kMinStatusCode]);
+			} else {
+				wrbuf->append("HTTP/1.1 ").append(std::to_string(status_code_)).append(" ").append(http_status_str(http_status(status_code_))).append("\r\n");
+			}
+			wrbuf->append(header_block_ ? header_block_->data() : "", HeaderBlockSize());
+			for (auto& header : headers_) {
+				wrbuf->append(header.first).append(": ").append(header.second).append("\r\n");
+			}
+			if (NeedsContentLength()) {
+				char digits[24];
+				wrbuf->append("Content-Length: ").append(digits, FormatSize(payload_.size(), digits)).append("\r\n");
+			}
+			for (auto& cookie : cookies_) {
+				wrbuf->append("Set-Cookie: ").append(cookie.first).append("=").append(cookie.second).append("\r\n");
+			}
+			wrbuf->append("\r\n");
+			if (HasBody() && !head_) {
+				wrbuf->append(payload_);
+			}
+			return wrbuf;
+		}
+
+		void Response::RemoveHeader(const string& key) {
+			for (auto it = headers_.begin(); it != headers_.end(); ++it) {
+				if (StringView(it->first).EqualsIgnoreCase(key)) {
+					headers_.erase(it);
+					break;
+				}
+			}
+		}
+
+		// 1xx, 204 and 304 never carry a body, a 304 only repeats the length
+		// of the representation when the handler sets it.
+		bool Response::HasBody() const {
+			return status_code_ >= 200 && status_code_ != 204 && status_code_ != 304;
+		}
+
+		bool Response::NeedsContentLength() const {
+			return HasBody() && !streaming_ && !HasHeader("Content-Length");
+		}
+
+		bool Response::HasHeader(const string& key) const {
+			for (auto& header : headers_) {
+				if (StringView(header.first).EqualsIgnoreCase(key))
+					return true;
+			}
+			return false;
+		}
+
+		// a Server header set by the handler replaces the one in the block.
+		size_t Response::HeaderBlockSize() const {
+			if (!header_block_)
+				return 0;
+			return HasHeader("Server") ? kDateHeaderSize : header_block_->size();
+		}
+
+		shared_ptr<const string> Response::RenderHeaderBlock(time_t now, const string& server_name) {
+			static const char* days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+			static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+			struct tm tm;
+#ifdef _WIN32
+			gmtime_s(&tm, &now);
+#else
+			gmtime_r(&now, &tm);
+#endif
+			char date[kDateHeaderSize];
+			char* p = date;
+			memcpy(p, "Date: ", 6);
+			memcpy(p + 6, days[tm.tm_wday], 3);
+			memcpy(p + 9, ", ", 2);
+			p = FormatDigits(tm.tm_mday, 2, p + 11);
+			*p++ = ' ';
+			memcpy(p, months[tm.tm_mon], 3);
+			p[3] = ' ';
+			p = FormatDigits(tm.tm_year + 1900, 4, p + 4);
+			*p++ = ' ';
+			p = FormatDigits(tm.tm_hour, 2, p);
+			*p++ = ':';
+			p = FormatDigits(tm.tm_min, 2, p);
+			*p++ = ':';
+			p = FormatDigits(tm.tm_sec, 2, p);
+			memcpy(p, " GMT\r\n", 6);
+			auto block = std::make_shared<string>(date, kDateHeaderSize);
+			if (!server_name.empty()) {
+				block->append("Server: ").append(server_name).append("\r\n");
+			}
+			return block;
 		}
 
 		Response::Response(shared_ptr<Session> session)
 			: session_(session),
-			status_code_(404) {
+			sequence_(0),
+			status_code_(404),
+			keep_alive_(false),
+			chunked_(true),
+			head_(false),
+			streaming_(false),
+			ended_(false),
+			cacheable_(false) {
+		}
+
+		Response::Response(shared_ptr<Session> session, int64_t sequence)
+			: session_(session),
+			sequence_(sequence),
+			status_code_(404),
+			keep_alive_(false),
+			chunked_(true),
+			head_(false),
+			streaming_(false),
+			ended_(false),
+			cacheable_(false) {
+		}
+
+		// a stream dropped without End can not be terminated cleanly, the
+		// connection is closed so the client sees a truncated body.
+		Response::~Response() {
+			if (streaming_ && !ended_) {
+				auto session = session_.lock();
+				if (session) {
+					session->Close();
+				}
+			}
 		}
 
 		shared_ptr<Session> Response::GetSession() const {
@@ -46,19 +306,35 @@ namespace moss {
 			status_code_ = code;
 		}
 
+		// header names compare case-insensitively, the first spelling set is kept.
 		void Response::SetHeader(const string& key, const string& value) {
-			headers_[key] = value;
+			for (auto& header : headers_) {
+				if (StringView(header.first).EqualsIgnoreCase(key)) {
+					header.second = value;
+					return;
+				}
+			}
+			headers_.push_back(std::make_pair(key, value));
 		}
 
+		// Content-Length is derived from the payload when the response is serialized.
 		void Response::SetPayload(const string& payload) {
-			std::ostringstream oss;
-			oss << payload.length();
-			SetHeader("Content-Length", oss.str());
-			payload_ = payload;
+			SetPayload(string(payload));
+		}
+
+		void Response::SetPayload(string&& payload) {
+			RemoveHeader("Content-Length");
+			payload_ = std::move(payload);
 		}
 
 		void Response::SetCookie(const string& name, const string& value) {
-			cookies_[name] = value;
+			for (auto& cookie : cookies_) {
+				if (cookie.first == name) {
+					cookie.second = value;
+					return;
+				}
+			}
+			cookies_.push_back(std::make_pair(name, value));
 		}
 
 		void Response::Redirect(const string& url) {
@@ -67,12 +343,11 @@ namespace moss {
 		}
 
 		string Response::Header(const string& key) const {
-			string value;
-			auto it = headers_.find(key);
-			if (it != headers_.end()) {
-				value = it->second;
+			for (auto& header : headers_) {
+				if (StringView(header.first).EqualsIgnoreCase(key))
+					return header.second;
 			}
-			return value;
+			return string();
 		}
 	} // namespace http
 } // namespace moss
@@ -1,43 +1,88 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
 #include <iostream>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "moss_exports.h"
 
 
+using std::pair;
 using std::shared_ptr;
 using std::string;
-using std::unordered_map;
+using std::vector;
 using std::weak_ptr;
 namespace moss {
 	class HttpServer;
+	class HttpServerImpl;
 	namespace http {
 		class Session;
 		class Response
 			: public std::enable_shared_from_this<Response> {
-			using Headers = unordered_map<string, string>;
-			using Cookies = unordered_map<string, string>;
+			// kept in insertion order, which is also the order they go out on the wire.
+			using Headers = vector<pair<string, string>>;
+			using Cookies = vector<pair<string, string>>;
 			friend std::ostream& operator<<(std::ostream& stream, const Response& response);
 			friend class moss::HttpServer;
+			friend class moss::HttpServerImpl;
 			int Send();
 		public:
 			MOSS_EXPORT Response(shared_ptr<Session> session);
+			Response(shared_ptr<Session> session, int64_t sequence);
+			MOSS_EXPORT ~Response();
 			shared_ptr<Session> GetSession() const;
 			MOSS_EXPORT void SetStatusCode(int code);
 			MOSS_EXPORT void SetHeader(const string& key, const string& value);
 			MOSS_EXPORT void SetPayload(const string& payload);
+			MOSS_EXPORT void SetPayload(string&& payload);
 			MOSS_EXPORT void SetCookie(const string& key, const string& value);
 			MOSS_EXPORT void Redirect(const string& url);
 			MOSS_EXPORT string Header(const string& key) const;
+			MOSS_EXPORT int StatusCode() const;
+			MOSS_EXPORT const string& Payload() const;
+			// marks a payload that repeats across requests, so derived output
+			// such as its compressed form may be memoized.
+			MOSS_EXPORT void SetCacheable(bool cacheable);
+			MOSS_EXPORT bool IsCacheable() const;
+			// chunked streaming: BeginStream sends the head, every Write one chunk
+			// and End the terminator. an HTTP/1.0 client gets the body as is, ended
+			// by closing the connection. off the loop thread Write blocks while the
+			// connection, or the responses queued behind earlier ones, are over the
+			// write high watermark. on the loop thread it fails with -1 instead and
+			// sends nothing, so large streams belong on a pool route.
+			MOSS_EXPORT int BeginStream();
+			MOSS_EXPORT int Write(const char* data, size_t size);
+			MOSS_EXPORT int Write(const string& chunk);
+			MOSS_EXPORT int End();
+			MOSS_EXPORT bool IsStreaming() const;
+			MOSS_EXPORT size_t SerializedSize() const;
+			MOSS_EXPORT shared_ptr<string> Serialize() const;
 		private:
+			void UpdateKeepAlive();
+			void RemoveHeader(const string& key);
+			bool HasBody() const;
+			bool NeedsContentLength() const;
+			bool HasHeader(const string& key) const;
+			size_t HeaderBlockSize() const;
+			static shared_ptr<const string> RenderHeaderBlock(time_t now, const string& server_name);
 			weak_ptr<Session> session_;
+			int64_t sequence_;
 			int status_code_;
+			bool keep_alive_;
+			bool chunked_;
+			// a response to HEAD keeps its headers, Content-Length included, and drops the body.
+			bool head_;
+			bool streaming_;
+			bool ended_;
+			bool cacheable_;
 			Headers headers_;
 			Cookies cookies_;
 			string payload_;
+			// "Date: ...\r\nServer: ...\r\n" shared by every response of an io loop.
+			shared_ptr<const string> header_block_;
 		};
 	} // namespace http
 } // namespace moss
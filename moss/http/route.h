@@ -2,40 +2,76 @@
 
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include "moss_exports.h"
 
 
 using std::shared_ptr;
 using std::string;
-using std::unordered_map;
+using std::vector;
 using std::weak_ptr;
 namespace moss {
 	namespace http {
 		class Application;
+		class Middleware;
 		class Request;
 		class Response;
 
+		// where Process runs: Pool hands the request to the worker threads, Inline
+		// runs it on the io loop thread that read it, so it must never block.
+		// Default defers to the application's policy.
+		enum class ExecutionPolicy {
+			Default,
+			Pool,
+			Inline
+		};
+
+		// how "~" patterns are matched: Nfa runs in time linear in the path with
+		// the supported regex subset, Regex is std::regex with full ecmascript
+		// syntax but backtracking. Default defers to the application's engine.
+		enum class PatternEngine {
+			Default,
+			Nfa,
+			Regex
+		};
+
 		class Route {
 			friend class Routes;
 			friend class Application;
-			void Append(shared_ptr<Route> sibling);
-			shared_ptr<Route> Match(const string& method);
 		public:
 			MOSS_EXPORT Route(const string& method, const string& path);
 			MOSS_EXPORT virtual ~Route();
 			MOSS_EXPORT shared_ptr<Application> CurrentApplication() const;
 			MOSS_EXPORT void AttachApplication(shared_ptr<Application> application);
 			MOSS_EXPORT virtual bool MatchMethod(const string& method) const;
-			MOSS_EXPORT virtual bool Match(const string& method, const string& pattern, const string& path, unordered_map<string, string>& args) const;
 			MOSS_EXPORT virtual string Method() const;
 			MOSS_EXPORT virtual string Path() const;
+			MOSS_EXPORT void SetExecutionPolicy(ExecutionPolicy policy);
+			MOSS_EXPORT ExecutionPolicy GetExecutionPolicy() const;
+			// takes effect when the route is installed.
+			MOSS_EXPORT void SetPatternEngine(PatternEngine engine);
+			MOSS_EXPORT PatternEngine GetPatternEngine() const;
+			// runs after the application's middleware, for this route only.
+			MOSS_EXPORT void Install(shared_ptr<Middleware> middleware);
+			// a body streaming route gets the body through OnBody as it arrives
+			// (chunked bodies already decoded) instead of buffered in the request.
+			MOSS_EXPORT void SetBodyStreaming(bool body_streaming);
+			MOSS_EXPORT bool IsBodyStreaming() const;
+			// runs on the io loop thread before Process, non-zero rejects the request.
+			MOSS_EXPORT virtual int OnBody(shared_ptr<Request> request, const char* data, size_t size);
 			MOSS_EXPORT virtual int Process(shared_ptr<Request> request, shared_ptr<Response> response) = 0;
 		protected:
 			weak_ptr<Application> application_;
-			shared_ptr<Route> sibling_;
 			string method_;
 			string path_;
+			ExecutionPolicy policy_;
+			PatternEngine pattern_engine_;
+			bool body_streaming_;
+			vector<shared_ptr<Middleware>> middlewares_;
+			// every middleware that applies, in OnBefore order, resolved by the
+			// application whenever its routes or middleware change.
+			vector<shared_ptr<Middleware>> chain_;
+			bool blocking_;
 		};
 	} // namespace http	
 } // namespace moss
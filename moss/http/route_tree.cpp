@@ -0,0 +1,275 @@
+#include "route_tree.h"
+
+#include <cstring>
+#include "path_pattern.h"
+#include "third_party/http_parser/http_parser.h"
+
+
+namespace moss {
+	namespace http {
+		namespace {
+			enum class TokenType {
+				Static,
+				Param,
+				Tail
+			};
+
+			struct Token {
+				TokenType type;
+				string text;
+				string expression;
+			};
+
+			// '.' included: in static text of a "~" pattern it still matches any
+			// character, as it always has, so such patterns stay off the tree.
+			bool IsRegexSyntax(char ch) {
+				return nullptr != strchr(".()[]*+?^$|\\", ch);
+			}
+
+			// splits a pattern into static runs and {name} / {name:regex} params,
+			// false for anything the tree can not match with the same semantics.
+			bool Tokenize(const string& pattern, vector<Token>& tokens) {
+				string text;
+				for (size_t i = 0; i < pattern.size(); i++) {
+					char ch = pattern[i];
+					if (ch != '{') {
+						if (IsRegexSyntax(ch) || ch == '}')
+							return false;
+						text.append(1, ch);
+						continue;
+					}
+					size_t depth = 0, colon = string::npos, j = i + 1;
+					for (; j < pattern.size(); j++) {
+						if (pattern[j] == '{') {
+							depth++;
+						} else if (pattern[j] == '}') {
+							if (0 == depth)
+								break;
+							depth--;
+						} else if (pattern[j] == ':' && colon == string::npos) {
+							colon = j;
+						}
+					}
+					if (j >= pattern.size())
+						return false;
+					// a param has to own a whole segment.
+					if (text.empty() ? tokens.empty() || tokens.back().type != TokenType::Static : text.back() != '/')
+						return false;
+					if (!text.empty()) {
+						tokens.push_back(Token{ TokenType::Static, text, string() });
+						text.clear();
+					}
+					if (colon == string::npos) {
+						tokens.push_back(Token{ TokenType::Param, pattern.substr(i + 1, j - i - 1), string() });
+					} else {
+						tokens.push_back(Token{ TokenType::Tail, pattern.substr(i + 1, colon - i - 1), pattern.substr(colon + 1, j - colon - 1) });
+					}
+					i = j;
+					if (i + 1 < pattern.size() && (tokens.back().type == TokenType::Tail || pattern[i + 1] != '/'))
+						return false;
+				}
+				if (!text.empty()) {
+					tokens.push_back(Token{ TokenType::Static, text, string() });
+				}
+				return true;
+			}
+
+			size_t CommonPrefix(const string& left, const StringView& right) {
+				size_t n = 0;
+				while (n < left.size() && n < right.size() && left[n] == right[n]) {
+					n++;
+				}
+				return n;
+			}
+
+			bool MatchesAnything(const string& expression) {
+				return expression == ".*" || expression == "(.*)";
+			}
+
+			const vector<string>& MethodNames() {
+				static const vector<string> names = []() {
+					vector<string> methods;
+					for (int i = 0; i < 64; i++) {
+						const char* name = http_method_str((http_method)i);
+						if (0 == strcmp(name, "<unknown>"))
+							break;
+						methods.push_back(name);
+					}
+					return methods;
+				}();
+				return names;
+			}
+		}
+
+		const int RouteTree::kMaxParams;
+
+		RouteTree::RouteTree()
+			: root_(new Node()) {
+		}
+
+		RouteTree::~RouteTree() {
+		}
+
+		// asks the route about every known method once, so the tree agrees with
+		// MatchMethod, overrides included, without calling it per request.
+		uint64_t RouteTree::MethodMask(const Route& route) {
+			auto& names = MethodNames();
+			uint64_t mask = 0;
+			for (size_t i = 0; i < names.size(); i++) {
+				if (route.MatchMethod(names[i])) {
+					mask |= 1ull << i;
+				}
+			}
+			return mask;
+		}
+
+		uint64_t RouteTree::MethodBit(const StringView& method) {
+			auto& names = MethodNames();
+			for (size_t i = 0; i < names.size(); i++) {
+				if (method == names[i])
+					return 1ull << i;
+			}
+			return 0;
+		}
+
+		bool RouteTree::Install(const string& path, shared_ptr<Route> route, PatternEngine engine) {
+			vector<Token> tokens;
+			if (!path.empty() && path[0] == '~') {
+				if (!Tokenize(path.substr(1), tokens))
+					return false;
+			} else {
+				tokens.push_back(Token{ TokenType::Static, path, string() });
+			}
+			Entry entry = { MethodMask(*route), route, vector<string>() };
+			Node* node = root_.get();
+			for (auto& token : tokens) {
+				if (token.type == TokenType::Static) {
+					node = InsertStatic(node, token.text);
+					continue;
+				}
+				if (entry.keys.size() >= kMaxParams)
+					return false;
+				entry.keys.push_back(token.text);
+				if (token.type == TokenType::Param) {
+					if (!node->param) {
+						node->param.reset(new Node());
+					}
+					node = node->param.get();
+					continue;
+				}
+				Node* tail = nullptr;
+				for (auto& it : node->tails) {
+					if (it->expression == token.expression && it->engine == engine) {
+						tail = it.get();
+						break;
+					}
+				}
+				if (!tail) {
+					unique_ptr<Node> created(new Node());
+					created->expression = token.expression;
+					created->engine = engine;
+					if (!MatchesAnything(token.expression)) {
+						string error;
+						created->matcher = std::make_shared<PathPattern>();
+						if (0 != created->matcher->CompileExpression(token.expression, engine, error))
+							return false;
+					}
+					tail = created.get();
+					node->tails.push_back(std::move(created));
+				}
+				node = tail;
+			}
+			node->entries.push_back(entry);
+			return true;
+		}
+
+		shared_ptr<Route> RouteTree::Find(const StringView& method, const StringView& path, unordered_map<string, string>& args) const {
+			StringView captures[kMaxParams];
+			const Entry* found = nullptr;
+			if (!Find(root_.get(), path, 0, MethodBit(method), captures, 0, found))
+				return nullptr;
+			for (size_t i = 0; i < found->keys.size(); i++) {
+				args[found->keys[i]] = captures[i].str();
+			}
+			return found->route;
+		}
+
+		// splits an edge where text diverges from it, so every node ends up with
+		// at most one static child per first character.
+		RouteTree::Node* RouteTree::InsertStatic(Node* node, const string& text) {
+			size_t pos = 0;
+			while (pos < text.size()) {
+				size_t index = node->indices.find(text[pos]);
+				if (index == string::npos) {
+					unique_ptr<Node> child(new Node());
+					child->prefix = text.substr(pos);
+					node->indices.append(1, text[pos]);
+					node->children.push_back(std::move(child));
+					return node->children.back().get();
+				}
+				Node* child = node->children[index].get();
+				size_t common = CommonPrefix(child->prefix, StringView(text).substr(pos));
+				if (common < child->prefix.size()) {
+					unique_ptr<Node> split(new Node());
+					split->prefix = child->prefix.substr(0, common);
+					split->indices.append(1, child->prefix[common]);
+					child->prefix = child->prefix.substr(common);
+					split->children.push_back(std::move(node->children[index]));
+					node->children[index] = std::move(split);
+					child = node->children[index].get();
+				}
+				node = child;
+				pos += common;
+			}
+			return node;
+		}
+
+		// tries static, then param, then trailing matches, only backing off to the
+		// next kind when the deeper match fails.
+		bool RouteTree::Find(const Node* node, const StringView& path, size_t pos, uint64_t method, StringView* captures, int depth, const Entry*& found) const {
+			if (pos == path.size()) {
+				for (auto& entry : node->entries) {
+					if (entry.methods & method) {
+						found = &entry;
+						return true;
+					}
+				}
+			}
+			if (pos < path.size()) {
+				size_t index = node->indices.find(path[pos]);
+				if (index != string::npos) {
+					const Node* child = node->children[index].get();
+					if (path.substr(pos).StartsWith(child->prefix) && Find(child, path, pos + child->prefix.size(), method, captures, depth, found))
+						return true;
+				}
+				if (node->param && depth < kMaxParams) {
+					size_t end = path.find('/', pos);
+					if (end == StringView::npos) {
+						end = path.size();
+					}
+					if (end > pos) {
+						captures[depth] = path.substr(pos, end - pos);
+						if (Find(node->param.get(), path, end, method, captures, depth + 1, found))
+							return true;
+					}
+				}
+			}
+			if (depth < kMaxParams) {
+				StringView rest = path.substr(pos);
+				for (auto& tail : node->tails) {
+					if (tail->matcher && !tail->matcher->Match(rest))
+						continue;
+					for (auto& entry : tail->entries) {
+						if (entry.methods & method) {
+							captures[depth] = rest;
+							found = &entry;
+							return true;
+						}
+					}
+				}
+			}
+			return false;
+		}
+	} // namespace http
+} // namespace moss
+
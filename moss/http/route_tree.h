@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "route.h"
+#include "utils/string_view.h"
+
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+namespace moss {
+	namespace http {
+		class PathPattern;
+		// compressed radix tree over route paths. a pattern ("~" prefixed) path
+		// goes in when it is made of static text, whole segment {name} params and
+		// at most one trailing {name:regex}, which captures the rest of the path.
+		// lookup prefers static over param over trailing matches at every node.
+		class RouteTree {
+			struct Entry {
+				uint64_t methods;
+				shared_ptr<Route> route;
+				vector<string> keys;
+			};
+			struct Node {
+				string prefix;
+				string indices;
+				vector<unique_ptr<Node>> children;
+				unique_ptr<Node> param;
+				vector<unique_ptr<Node>> tails;
+				string expression;
+				PatternEngine engine;
+				// null when the expression matches anything.
+				shared_ptr<PathPattern> matcher;
+				vector<Entry> entries;
+			};
+		public:
+			static const int kMaxParams = 16;
+			RouteTree();
+			~RouteTree();
+			// false when the path needs the generic pattern matcher instead.
+			bool Install(const string& path, shared_ptr<Route> route, PatternEngine engine);
+			shared_ptr<Route> Find(const StringView& method, const StringView& path, unordered_map<string, string>& args) const;
+			static uint64_t MethodMask(const Route& route);
+			static uint64_t MethodBit(const StringView& method);
+		private:
+			Node* InsertStatic(Node* node, const string& text);
+			bool Find(const Node* node, const StringView& path, size_t pos, uint64_t method, StringView* captures, int depth, const Entry*& found) const;
+			unique_ptr<Node> root_;
+		};
+	} // namespace http
+} // namespace moss
+
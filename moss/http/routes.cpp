@@ -1,47 +1,41 @@
 #include "routes.h"
 
 #include "route.h"
+#include "path_pattern.h"
 
 
 namespace moss {
 	namespace http {
-		int Routes::Install(shared_ptr<Route> route) {
+		int Routes::Install(shared_ptr<Route> route, PatternEngine engine, string& error) {
 			string path = route->Path();
 			if (path.empty())
 				return -1;
-			if (path.at(0) == '~') {
-				pattern_routes_.push_back(route);
-				return 0;
-			}
-			auto it = normal_routes_.find(route->Path());
-			if (it != normal_routes_.end()) {
-				it->second->Append(route);
-			} else {
-				normal_routes_.insert(std::make_pair(route->Path(), route));
+			if (!tree_.Install(path, route, engine)) {
+				auto pattern = std::make_shared<PathPattern>();
+				if (0 != pattern->Compile(path.substr(1), engine, error))
+					return -1;
+				pattern_routes_.push_back(std::make_pair(route, pattern));
 			}
+			routes_.push_back(route);
 			return 0;
 		}
 
-		shared_ptr<Route> Routes::Find(const string& method, const string& path, unordered_map<string, string>& args) {
-			auto it = normal_routes_.find(path);
-			if (it != normal_routes_.end()) {
-				if (it->second->MatchMethod(method)) {
-					return it->second;
-				}
-				auto route = it->second->Match(method);
-				if (route) {
-					return route;
-				}
-			}
+		shared_ptr<Route> Routes::Find(const StringView& method, const StringView& path, unordered_map<string, string>& args) {
+			auto route = tree_.Find(method, path, args);
+			if (route || pattern_routes_.empty())
+				return route;
+			string method_name = method.str();
 			for (auto it = pattern_routes_.begin(); it != pattern_routes_.end(); ++it) {
-				string route_path = (*it)->Path();
-				string pattern = route_path.substr(1);
-				if ((*it)->Match(method, pattern, path, args)) {
-					return *it;
+				if (it->first->MatchMethod(method_name) && it->second->Match(path, args)) {
+					return it->first;
 				}
 			}
 			return nullptr;
 		}
+
+		const vector<shared_ptr<Route>>& Routes::All() const {
+			return routes_;
+		}
 	} // namespace http
 } // namespace moss
 
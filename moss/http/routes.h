@@ -3,7 +3,9 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
+#include "route_tree.h"
 #include "moss_exports.h"
 
 
@@ -14,14 +16,19 @@ using std::vector;
 namespace moss {
 	namespace http {
 		class Route;
+		class PathPattern;
+		// static paths and plain patterns resolve through the tree, patterns it
+		// can not express are tried afterwards in install order.
 		class Routes {
-			using NormalRoutes = unordered_map<string, shared_ptr<Route>>;
-			using PatternRoutes = vector<shared_ptr<Route>>;
+			using PatternRoutes = vector<std::pair<shared_ptr<Route>, shared_ptr<PathPattern>>>;
 		public:
-			int Install(shared_ptr<Route> route);
-			shared_ptr<Route> Find(const string& method, const string& path, unordered_map<string, string>& args);
+			// -1 with the reason in error when the pattern does not compile.
+			int Install(shared_ptr<Route> route, PatternEngine engine, string& error);
+			shared_ptr<Route> Find(const StringView& method, const StringView& path, unordered_map<string, string>& args);
+			const vector<shared_ptr<Route>>& All() const;
 		private:
-			NormalRoutes normal_routes_;
+			vector<shared_ptr<Route>> routes_;
+			RouteTree tree_;
 			PatternRoutes pattern_routes_;
 		};
 	} // namespace http
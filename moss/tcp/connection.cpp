@@ -21,11 +21,11 @@ namespace moss {
 	}
 
 	shared_ptr<void> Connection::UserContext() {
-		return user_context_.lock();
+		return user_context_;
 	}
 
 	shared_ptr<void> Connection::UserContext() const {
-		return user_context_.lock();
+		return user_context_;
 	}
 } // namespace moss
 
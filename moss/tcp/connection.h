@@ -18,15 +18,25 @@ namespace moss {
 		MOSS_EXPORT Connection(int64_t id);
 		MOSS_EXPORT virtual ~Connection();
 		MOSS_EXPORT int64_t Id() const;
+		// the connection owns user_context, it lives as long as the connection.
 		MOSS_EXPORT void SetUserContext(shared_ptr<void> user_context);
 		MOSS_EXPORT shared_ptr<void> UserContext();
 		MOSS_EXPORT shared_ptr<void> UserContext() const;
 		MOSS_EXPORT virtual int Write(shared_ptr<string> wrbuf) = 0;
 		MOSS_EXPORT virtual int Close() = 0;
+		// arms (or rearms) the connection timeout, 0 cancels it. loop thread only,
+		// i.e. from inside TcpEventHandler callbacks; expiry calls OnTimeout.
+		MOSS_EXPORT virtual int SetTimeout(int64_t milliseconds) = 0;
+		// holds reading off until released, independent of the pause the write
+		// watermarks apply. loop thread only.
+		MOSS_EXPORT virtual int SetReadPaused(bool paused) = 0;
 		MOSS_EXPORT virtual string Ip() const = 0;
+		// index of the io loop the connection lives on, stable for its lifetime.
+		MOSS_EXPORT virtual int LoopId() const = 0;
+		MOSS_EXPORT virtual bool IsLoopThread() const = 0;
 	private:
 		int64_t id_;
-		weak_ptr<void> user_context_;
+		shared_ptr<void> user_context_;
 	};
 } // namespace moss
 
@@ -4,6 +4,18 @@
 namespace moss {
 	TcpEventHandler::~TcpEventHandler() {
 	}
+
+	int TcpEventHandler::OnWritability(shared_ptr<Connection> /*connection*/, bool /*writable*/) {
+		return 0;
+	}
+
+	int TcpEventHandler::OnTimeout(shared_ptr<Connection> /*connection*/) {
+		return 0;
+	}
+
+	int TcpEventHandler::OnTick(int /*loop_id*/) {
+		return 0;
+	}
 } // namespace moss
 
 
@@ -13,10 +13,16 @@ namespace moss {
 	public:
 		virtual ~TcpEventHandler();
 		virtual int OnCreate(shared_ptr<Connection> connection) = 0;
-		virtual int OnRead(shared_ptr<Connection> connection, shared_ptr<string> rdbuf, int size) = 0;
+		virtual int OnRead(shared_ptr<Connection> connection, const char* data, size_t size) = 0;
 		virtual int OnWrite(shared_ptr<Connection> connection, shared_ptr<string> wrbuf, int status) = 0;
 		virtual int OnClose(shared_ptr<Connection> connection) = 0;
 		virtual int OnError(int64_t id, const string& message) = 0;
+		// writable becomes false once the pending bytes of the connection pass
+		// the high watermark (reading is paused), and true again below the low one.
+		virtual int OnWritability(shared_ptr<Connection> connection, bool writable);
+		virtual int OnTimeout(shared_ptr<Connection> connection);
+		// called on each io loop thread when it starts and then once a second.
+		virtual int OnTick(int loop_id);
 	};
 } // namespace moss
 
@@ -7,7 +7,11 @@
 namespace moss {
 	TcpServer::TcpServer(shared_ptr<TcpEventHandler> tcp_event_handler)
 		: tcp_event_handler_(tcp_event_handler),
-		port_(0) {
+		port_(0),
+		reuse_port_(false),
+		write_high_watermark_(1024 * 1024),
+		write_low_watermark_(256 * 1024),
+		timer_resolution_(100) {
 	}
 
 	TcpServer::~TcpServer() {
@@ -29,11 +33,54 @@ namespace moss {
 		return port_;
 	}
 
-	int TcpServer::Start(const string& ip, int port) {
+	void TcpServer::SetReusePort(bool reuse_port) {
+		reuse_port_ = reuse_port;
+	}
+
+	bool TcpServer::IsReusePort() const {
+		return reuse_port_;
+	}
+
+	void TcpServer::SetWriteWatermarks(size_t high, size_t low) {
+		if (low > high) {
+			low = high;
+		}
+		write_high_watermark_ = high;
+		write_low_watermark_ = low;
+	}
+
+	size_t TcpServer::WriteHighWatermark() const {
+		return write_high_watermark_;
+	}
+
+	size_t TcpServer::WriteLowWatermark() const {
+		return write_low_watermark_;
+	}
+
+	void TcpServer::SetTimerResolution(int milliseconds) {
+		timer_resolution_ = milliseconds > 0 ? milliseconds : 1;
+	}
+
+	int TcpServer::TimerResolution() const {
+		return timer_resolution_;
+	}
+
+	BufferPoolStats TcpServer::ReadBufferStats() const {
+		BufferPoolStats stats = { 0, 0, 0 };
+		if (impl_) {
+			stats = impl_->ReadBufferStats();
+		}
+		return stats;
+	}
+
+	int TcpServer::Start(const string& ip, int port, int workers/* = 1*/) {
 		ip_ = ip.c_str();
 		port_ = port;
 		impl_ = std::make_shared<TcpServerImpl>(shared_from_this());
-		return impl_->Start(ip, port, 1);
+		if (workers < 1) {
+			workers = 1;
+		}
+		return impl_->Start(ip, port, workers, reuse_port_);
 	}
 
 	int TcpServer::Stop() {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include "moss_exports.h"
@@ -8,6 +9,12 @@
 using std::shared_ptr;
 using std::string;
 namespace moss {
+	struct BufferPoolStats {
+		int64_t hits;
+		int64_t misses;
+		int64_t bytes_held;
+	};
+
 	class TcpEventHandler;
 	class TcpServerImpl;
 	class TcpServer
@@ -20,13 +27,28 @@ namespace moss {
 		shared_ptr<TcpServerImpl> GetImpl();
 		MOSS_EXPORT string ListenIp() const;
 		MOSS_EXPORT int ListenPort() const;
-		MOSS_EXPORT int Start(const string& ip, int port);
+		// opt-in. without it Start runs the accept loop on the calling thread
+		// until Stop; with it every worker binds its own listener and Start
+		// returns once they all listen.
+		MOSS_EXPORT void SetReusePort(bool reuse_port);
+		MOSS_EXPORT bool IsReusePort() const;
+		MOSS_EXPORT void SetWriteWatermarks(size_t high, size_t low);
+		MOSS_EXPORT size_t WriteHighWatermark() const;
+		MOSS_EXPORT size_t WriteLowWatermark() const;
+		MOSS_EXPORT void SetTimerResolution(int milliseconds);
+		MOSS_EXPORT int TimerResolution() const;
+		MOSS_EXPORT BufferPoolStats ReadBufferStats() const;
+		MOSS_EXPORT int Start(const string& ip, int port, int workers = 1);
 		MOSS_EXPORT int Stop();
 	private:
 		shared_ptr<TcpEventHandler> tcp_event_handler_;
 		shared_ptr<TcpServerImpl> impl_;
 		string ip_;
 		int port_;
+		bool reuse_port_;
+		size_t write_high_watermark_;
+		size_t write_low_watermark_;
+		int timer_resolution_;
 	};
 } // namespace moss
 
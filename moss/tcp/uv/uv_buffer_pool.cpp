@@ -0,0 +1,54 @@
+#include "uv_buffer_pool.h"
+
+
+namespace moss {
+	UvBufferPool::UvBufferPool(size_t buffer_size, size_t max_buffers)
+		: buffer_size_(buffer_size),
+		max_buffers_(max_buffers),
+		hits_(0),
+		misses_(0),
+		bytes_held_(0) {
+	}
+
+	UvBufferPool::~UvBufferPool() {
+		for (auto buffer : buffers_) {
+			delete[] buffer;
+		}
+	}
+
+	size_t UvBufferPool::BufferSize() const {
+		return buffer_size_;
+	}
+
+	char* UvBufferPool::Acquire() {
+		if (!buffers_.empty()) {
+			char* buffer = buffers_.back();
+			buffers_.pop_back();
+			hits_++;
+			return buffer;
+		}
+		misses_++;
+		bytes_held_ += (int64_t)buffer_size_;
+		return new char[buffer_size_];
+	}
+
+	void UvBufferPool::Release(char* buffer) {
+		if (!buffer)
+			return;
+		if (buffers_.size() >= max_buffers_) {
+			bytes_held_ -= (int64_t)buffer_size_;
+			delete[] buffer;
+			return;
+		}
+		buffers_.push_back(buffer);
+	}
+
+	BufferPoolStats UvBufferPool::GetStats() const {
+		BufferPoolStats stats;
+		stats.hits = hits_;
+		stats.misses = misses_;
+		stats.bytes_held = bytes_held_;
+		return stats;
+	}
+} // namespace moss
+
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "../tcp_server.h"
+
+
+using std::vector;
+namespace moss {
+	class UvBufferPool {
+	public:
+		UvBufferPool(size_t buffer_size, size_t max_buffers);
+		~UvBufferPool();
+		size_t BufferSize() const;
+		char* Acquire();
+		void Release(char* buffer);
+		BufferPoolStats GetStats() const;
+	private:
+		size_t buffer_size_;
+		size_t max_buffers_;
+		vector<char*> buffers_;
+		std::atomic_int64_t hits_;
+		std::atomic_int64_t misses_;
+		std::atomic_int64_t bytes_held_;
+	};
+} // namespace moss
+
@@ -2,68 +2,65 @@
 
 #include "utils/logger.h"
 #include "uv_worker.h"
+#include "uv_buffer_pool.h"
 #include "uv_tcp_server.h"
 #include "../tcp_event_handler.h"
 
 
 namespace moss {
 	namespace {
+		UvWorker* WorkerFromHandle(void* handle) {
+			uv_loop_t* loop = uv_handle_get_loop(static_cast<uv_handle_t*>(handle));
+			return static_cast<UvWorker*>(uv_loop_get_data(loop));
+		}
+
 		shared_ptr<UvConnection> SharedFromHandle(void* handle) {
-			UvConnection* pthis = static_cast<UvConnection*>(uv_handle_get_data(static_cast<uv_handle_t*>(handle)));
-			if (!pthis)
-				return nullptr;
-			return pthis->SharedFromPodPointer();
+			int64_t id = DataToConnectionId(uv_handle_get_data(static_cast<uv_handle_t*>(handle)));
+			return WorkerFromHandle(handle)->GetConnection(id);
 		}
 	}
-	void AllocCallback(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
-		UvConnection* connection = static_cast<UvConnection*>(uv_handle_get_data(handle));
-		if (!connection)
-			return;
-		auto rdbuf = connection->ReadBuffer();
-		if (rdbuf->size() < suggested_size) {
-			rdbuf->resize(suggested_size);
-		}
-		buf->base = (char*)rdbuf->c_str();
-		buf->len = (unsigned long)suggested_size;
+	void AllocCallback(uv_handle_t* handle, size_t /*suggested_size*/, uv_buf_t* buf) {
+		auto pool = WorkerFromHandle(handle)->ReadBufferPool();
+		buf->base = pool->Acquire();
+		buf->len = (unsigned long)pool->BufferSize();
+	}
+
+	void ReleaseReadBuffer(uv_stream_t* handle, const uv_buf_t* buf) {
+		WorkerFromHandle(handle)->ReadBufferPool()->Release(buf->base);
 	}
 
 	void ReadCallback(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
 		auto connection = SharedFromHandle(handle);
-		if (!connection)
+		if (!connection) {
+			ReleaseReadBuffer(handle, buf);
 			return;
+		}
 		auto tcp_event_handler = connection->GetIoEventHandler();
 		if (nread > 0) {
 			if (tcp_event_handler) {
-				tcp_event_handler->OnRead(connection, connection->ReadBuffer(), (int)nread);
+				tcp_event_handler->OnRead(connection, buf->base, (size_t)nread);
 			}
+			ReleaseReadBuffer(handle, buf);
 		} else {
-#ifdef _WIN32
-			if (WSAEWOULDBLOCK != WSAGetLastError()) {
-#else
-			if (errno != EAGAIN) {
-#endif
-				if (tcp_event_handler) {
-					if (nread != UV_EOF) {
-						tcp_event_handler->OnError(connection->Id(), uv_err_name((int)nread));
-					}
-					tcp_event_handler->OnClose(connection);
+			ReleaseReadBuffer(handle, buf);
+			if (nread < 0) {
+				if (tcp_event_handler && nread != UV_EOF) {
+					tcp_event_handler->OnError(connection->Id(), uv_err_name((int)nread));
 				}
-				//connection->Close();
-				connection->Cleanup();
+				connection->DoClose();
 			}
 		}
 	}
 
 	void WriteCallback(uv_write_t* req, int status) {
-		auto connection = SharedFromHandle(req);
-		free(req);
-		if (!connection)
+		UvWriteRequest* write_request = container_of(req, UvWriteRequest, req);
+		auto worker = WorkerFromHandle(req->handle);
+		auto connection = worker->GetConnection(write_request->connection_id);
+		if (!connection) {
+			worker->ReleaseWriteRequest(write_request);
 			return;
-		auto tcp_event_handler = connection->GetIoEventHandler();
-		if (tcp_event_handler) {
-			tcp_event_handler->OnWrite(connection, connection->WriteBuffer(), status);
 		}
-		connection->WriteFinished();
+		connection->WriteFinished(write_request, status);
 	}
 
 	void CloseCallback(uv_handle_t* handle) {
@@ -81,12 +78,15 @@ namespace moss {
 		: Connection(id),
 		worker_(worker),
 		handle_(handle),
-		rdbuf_(std::make_shared<string>()),
-		mutex_(std::make_shared<mutex>()),
-		wq_(std::make_shared<WriteQueue>()),
-		wqs_(std::make_shared<WriteQueue>()) {
-		uv_handle_set_data((uv_handle_t*)handle_.get(), this);
-		ip_ = std::make_shared<string>(GetIp());
+		loop_id_(worker ? worker->Id() : -1),
+		timeout_(id),
+		queued_bytes_(0),
+		write_scheduled_(false),
+		close_pending_(false),
+		read_paused_(false),
+		read_held_(false) {
+		uv_handle_set_data((uv_handle_t*)handle_.get(), ConnectionIdToData(id));
+		ip_ = GetIp();
 		//moss::logger::Debug() << "UvConnection: " << id;
 	}
 
@@ -106,10 +106,7 @@ namespace moss {
 	}
 
 	shared_ptr<UvConnection> UvConnection::SharedFromPodPointer() const {
-		auto worker = GetWorker();
-		if (!worker)
-			return nullptr;
-		return worker->GetConnection(Id());
+		return const_cast<UvConnection*>(this)->shared_from_this();
 	}
 
 	shared_ptr<TcpServerImpl> UvConnection::GetUvTcpServer() const {
@@ -123,26 +120,38 @@ namespace moss {
 		return handle_.get();
 	}
 
-	shared_ptr<string> UvConnection::ReadBuffer() {
-		return rdbuf_;
-	}
-
-	shared_ptr<string> UvConnection::WriteBuffer() {
-		if (wqs_->empty())
-			return nullptr;
-		return wqs_->front();
+	void UvConnection::WriteFinished(UvWriteRequest* req, int status) {
+		auto worker = GetWorker();
+		auto tcp_event_handler = GetIoEventHandler();
+		if (tcp_event_handler) {
+			auto self = shared_from_this();
+			for (auto& wrbuf : req->wrbufs) {
+				tcp_event_handler->OnWrite(self, wrbuf, status);
+			}
+		}
+		if (worker) {
+			worker->ReleaseWriteRequest(req);
+		}
+		if (close_pending_ && 0 == uv_stream_get_write_queue_size((uv_stream_t*)handle_.get())) {
+			DoClose();
+			return;
+		}
+		UpdateWritability();
 	}
 
-	void UvConnection::WriteFinished() {
-		if (wqs_->empty())
-			return;
-		wqs_->pop_front();
+	void UvConnection::WriteFinished(shared_ptr<string> wrbuf, int status) {
+		auto tcp_event_handler = GetIoEventHandler();
+		if (tcp_event_handler) {
+			tcp_event_handler->OnWrite(shared_from_this(), wrbuf, status);
+		}
+		UpdateWritability();
 	}
 
 	void UvConnection::Cleanup() {
 		auto worker = GetWorker();
 		if (!worker)
 			return;
+		worker->GetTimingWheel()->Cancel(&timeout_);
 		worker->CloseConnection(Id());
 	}
 
@@ -150,13 +159,24 @@ namespace moss {
 		uv_read_start((uv_stream_t*)handle_.get(), &AllocCallback, &ReadCallback);
 	}
 
+	size_t UvConnection::PendingWriteBytes() const {
+		return uv_stream_get_write_queue_size((uv_stream_t*)handle_.get()) + queued_bytes_;
+	}
+
 	int UvConnection::Write(shared_ptr<string> wrbuf) {
 		auto worker = worker_.lock();
 		if (!worker)
 			return -1;
-		std::lock_guard<mutex> lock(*mutex_);
-		wq_->push_back(wrbuf);
-		worker->Write(Id());
+		if (wrbuf && TryWrite(wrbuf))
+			return 0;
+		if (wrbuf) {
+			queued_bytes_ += wrbuf->size();
+		}
+		worker->Write(Id(), wrbuf);
+		// a producer on the loop thread sees the backlog before the loop runs again.
+		if (wrbuf && worker->IsLoopThread()) {
+			UpdateWritability();
+		}
 		return 0;
 	}
 
@@ -164,54 +184,209 @@ namespace moss {
 		auto worker = worker_.lock();
 		if (!worker)
 			return -1;
-		std::lock_guard<mutex> lock(*mutex_);
-		wq_->push_back(nullptr);
-		worker->Write(Id());
+		if (TryClose())
+			return 0;
+		worker->Write(Id(), nullptr);
+		return 0;
+	}
+
+	int UvConnection::SetTimeout(int64_t milliseconds) {
+		auto worker = GetWorker();
+		if (!worker || !worker->IsLoopThread())
+			return -1;
+		auto timing_wheel = worker->GetTimingWheel();
+		if (milliseconds <= 0 || uv_is_closing((uv_handle_t*)handle_.get())) {
+			timing_wheel->Cancel(&timeout_);
+		} else {
+			timing_wheel->Schedule(&timeout_, milliseconds);
+		}
+		return 0;
+	}
+
+	// reading runs only while neither the caller nor the watermarks hold it off.
+	int UvConnection::SetReadPaused(bool paused) {
+		auto worker = GetWorker();
+		if (!worker || !worker->IsLoopThread())
+			return -1;
+		if (paused == read_held_)
+			return 0;
+		read_held_ = paused;
+		if (read_paused_ || uv_is_closing((uv_handle_t*)handle_.get()))
+			return 0;
+		if (paused) {
+			uv_read_stop((uv_stream_t*)handle_.get());
+		} else {
+			uv_read_start((uv_stream_t*)handle_.get(), &AllocCallback, &ReadCallback);
+		}
 		return 0;
 	}
 
 	string UvConnection::Ip() const {
-		if (!ip_)
-			return string();
-		return *ip_;
+		return ip_;
+	}
+
+	int UvConnection::LoopId() const {
+		return loop_id_;
+	}
+
+	bool UvConnection::IsLoopThread() const {
+		auto worker = GetWorker();
+		return worker && worker->IsLoopThread();
 	}
 
 	int UvConnection::Write() {
 		int write_count = 0;
-		{
-			std::lock_guard<mutex> lock(*mutex_);
-			if (!wq_->empty()) {
-				wqs_->swap(*wq_);
-				//wqs_->insert(wqs_->end(), wq_->begin(), wq_->end());
-				//wq_->clear();
+		WriteQueue wq;
+		wq.swap(wq_);
+		size_t bytes = 0;
+		for (auto& wrbuf : wq) {
+			if (wrbuf) {
+				bytes += wrbuf->size();
 			}
 		}
-		for (auto wrbuf: *wqs_) {
-			if (!wrbuf) {
-				//if(uv_is_active((uv_handle_t*)handle_.get())) {
-				//	Write(nullptr);
-				//	continue;
-				//}
-				uv_close((uv_handle_t*)handle_.get(), &CloseCallback);
-				//uv_tcp_close_reset(handle_.get(), &CloseCallback);
-				wqs_->clear();
+		queued_bytes_ -= bytes;
+		auto worker = GetWorker();
+		if (!worker || close_pending_ || uv_is_closing((uv_handle_t*)handle_.get())) {
+			CancelWrites(wq.begin(), wq.end());
+			return write_count;
+		}
+		auto it = wq.begin();
+		while (it != wq.end()) {
+			if (!*it) {
+				if (0 == uv_stream_get_write_queue_size((uv_stream_t*)handle_.get())) {
+					DoClose();
+				} else {
+					close_pending_ = true;
+				}
 				write_count++;
 				break;
 			}
-			uv_buf_t buffer;
-			buffer.base = (char*)wrbuf->c_str();
-			buffer.len = (unsigned long)wrbuf->size();
-			uv_write_t* req = (uv_write_t*)calloc(1, sizeof(uv_write_t));
-			uv_handle_set_data((uv_handle_t*)req, this);
-			int retval = uv_write(req, (uv_stream_t*)handle_.get(), &buffer, 1, &WriteCallback);
+			UvWriteRequest* req = worker->AcquireWriteRequest();
+			req->connection_id = Id();
+			for (; it != wq.end() && *it && req->bufs.size() < IOV_MAX; ++it) {
+				auto& wrbuf = *it;
+				req->wrbufs.push_back(wrbuf);
+				req->bufs.push_back(uv_buf_init((char*)wrbuf->data(), (unsigned int)wrbuf->size()));
+			}
+			int retval = uv_write(&req->req, (uv_stream_t*)handle_.get(), req->bufs.data(), (unsigned int)req->bufs.size(), &WriteCallback);
 			if (0 != retval) {
-				moss::logger::Debug(__FILE__, __LINE__) << "uv_write: wrlen->" << wrbuf->size() << ", retval->" << retval;
+				// the stream is unusable: fail this batch and the rest, then close.
+				moss::logger::Debug(__FILE__, __LINE__) << "uv_write: nbufs->" << req->bufs.size() << ", retval->" << retval;
+				WriteFinished(req, retval);
+				DoClose();
+				CancelWrites(it, wq.end());
+				return write_count;
 			}
-			write_count += (0 == retval) ? 1 : 0;
-		}		
+			write_count += (int)req->wrbufs.size();
+		}
+		UpdateWritability();
 		return write_count;
 	}
 
+	// writes the connection will never send still complete, as cancelled.
+	void UvConnection::CancelWrites(WriteQueue::const_iterator begin, WriteQueue::const_iterator end) {
+		for (auto it = begin; it != end; ++it) {
+			if (*it) {
+				WriteFinished(*it, UV_ECANCELED);
+			}
+		}
+	}
+
+	// loop thread fast path: when nothing is queued ahead of wrbuf, hand it to
+	// the socket directly and only queue what uv_try_write could not send.
+	bool UvConnection::TryWrite(shared_ptr<string> wrbuf) {
+		auto worker = GetWorker();
+		if (!worker || !worker->IsLoopThread())
+			return false;
+		uv_stream_t* stream = (uv_stream_t*)handle_.get();
+		if (0 != queued_bytes_ || !wq_.empty() || close_pending_ || uv_is_closing((uv_handle_t*)stream))
+			return false;
+		if (0 != uv_stream_get_write_queue_size(stream))
+			return false;
+		uv_buf_t buf = uv_buf_init((char*)wrbuf->data(), (unsigned int)wrbuf->size());
+		int written = uv_try_write(stream, &buf, 1);
+		if (UV_EAGAIN == written) {
+			written = 0;
+		} else if (written < 0) {
+			return false;
+		}
+		if ((size_t)written == wrbuf->size()) {
+			worker->DeferWriteCompletion(shared_from_this(), wrbuf);
+			return true;
+		}
+		UvWriteRequest* req = worker->AcquireWriteRequest();
+		req->connection_id = Id();
+		req->wrbufs.push_back(wrbuf);
+		req->bufs.push_back(uv_buf_init(buf.base + written, buf.len - written));
+		int retval = uv_write(&req->req, stream, req->bufs.data(), (unsigned int)req->bufs.size(), &WriteCallback);
+		if (0 != retval) {
+			// part of wrbuf is on the wire already, so it can not be queued again:
+			// report it failed and drop the connection.
+			moss::logger::Debug(__FILE__, __LINE__) << "uv_write: remainder->" << buf.len - written << ", retval->" << retval;
+			worker->ReleaseWriteRequest(req);
+			worker->DeferWriteCompletion(shared_from_this(), wrbuf, retval);
+			DoClose();
+			return true;
+		}
+		UpdateWritability();
+		return true;
+	}
+
+	bool UvConnection::TryClose() {
+		auto worker = GetWorker();
+		if (!worker || !worker->IsLoopThread())
+			return false;
+		if (0 != queued_bytes_ || !wq_.empty())
+			return false;
+		if (0 == uv_stream_get_write_queue_size((uv_stream_t*)handle_.get())) {
+			DoClose();
+		} else {
+			close_pending_ = true;
+		}
+		return true;
+	}
+
+	// loop thread: pause reading while the peer is not draining what we send.
+	void UvConnection::UpdateWritability() {
+		auto worker = GetWorker();
+		if (!worker || 0 == worker->WriteHighWatermark())
+			return;
+		if (uv_is_closing((uv_handle_t*)handle_.get()))
+			return;
+		size_t pending = PendingWriteBytes();
+		bool writable;
+		if (!read_paused_ && pending > worker->WriteHighWatermark()) {
+			if (!read_held_) {
+				uv_read_stop((uv_stream_t*)handle_.get());
+			}
+			read_paused_ = true;
+			writable = false;
+		} else if (read_paused_ && pending <= worker->WriteLowWatermark()) {
+			if (!read_held_) {
+				uv_read_start((uv_stream_t*)handle_.get(), &AllocCallback, &ReadCallback);
+			}
+			read_paused_ = false;
+			writable = true;
+		} else {
+			return;
+		}
+		auto tcp_event_handler = GetIoEventHandler();
+		if (tcp_event_handler) {
+			tcp_event_handler->OnWritability(shared_from_this(), writable);
+		}
+	}
+
+	void UvConnection::DoClose() {
+		close_pending_ = false;
+		if (uv_is_closing((uv_handle_t*)handle_.get()))
+			return;
+		auto worker = GetWorker();
+		if (worker) {
+			worker->GetTimingWheel()->Cancel(&timeout_);
+		}
+		uv_close((uv_handle_t*)handle_.get(), &CloseCallback);
+	}
+
 	string UvConnection::GetIp() const {
 		const int max_ip_length = 64;
 		char buffer[max_ip_length] = { 0 };
@@ -1,21 +1,22 @@
 #pragma once
 
-#include <deque>
+#include <atomic>
 #include <vector>
 #include <uv.h>
 #include "../connection.h"
+#include "utils/timing_wheel.h"
 
 
-using std::deque;
 using std::vector;
 namespace moss {
 	class TcpEventHandler;
 	class UvWorker;
 	class TcpServerImpl;
+	struct UvWriteRequest;
 	class UvConnection
 		: public Connection,
 		public std::enable_shared_from_this<UvConnection> {
-		using WriteQueue = deque<shared_ptr<string>>;
+		using WriteQueue = vector<shared_ptr<string>>;
 		friend class UvWorker;
 	public:
 		UvConnection(int64_t id, shared_ptr<uv_tcp_t> handle, shared_ptr<UvWorker> worker);
@@ -25,25 +26,38 @@ namespace moss {
 		shared_ptr<UvConnection> SharedFromPodPointer() const;
 		shared_ptr<TcpServerImpl> GetUvTcpServer() const;
 		uv_tcp_t* Handle();
-		shared_ptr<string> ReadBuffer();
-		shared_ptr<string> WriteBuffer();
-		void WriteFinished();
+		void WriteFinished(UvWriteRequest* req, int status);
+		void WriteFinished(shared_ptr<string> wrbuf, int status);
 		void Cleanup();
+		void DoClose();
 		void Start();
+		size_t PendingWriteBytes() const;
 
 		int Write(shared_ptr<string> wrbuf) override;
 		int Close() override;
+		int SetTimeout(int64_t milliseconds) override;
+		int SetReadPaused(bool paused) override;
 		string Ip() const override;
+		int LoopId() const override;
+		bool IsLoopThread() const override;
 	private:
 		int Write();
+		bool TryWrite(shared_ptr<string> wrbuf);
+		void CancelWrites(WriteQueue::const_iterator begin, WriteQueue::const_iterator end);
+		bool TryClose();
+		void UpdateWritability();
 		string GetIp() const;
 		weak_ptr<UvWorker> worker_;
 		shared_ptr<uv_tcp_t> handle_;
-		shared_ptr<string> ip_;
-		shared_ptr<string> rdbuf_;
-		shared_ptr<mutex> mutex_;
-		shared_ptr<WriteQueue> wq_;
-		shared_ptr<WriteQueue> wqs_;
+		string ip_;
+		int loop_id_;
+		WriteQueue wq_;
+		TimingWheel::Entry timeout_;
+		std::atomic<size_t> queued_bytes_;
+		bool write_scheduled_;
+		bool close_pending_;
+		bool read_paused_;
+		bool read_held_;
 	};
 } // namespace moss
 
@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include "uv_types.h"
 #include "uv_worker.h"
+#include "uv_buffer_pool.h"
 #include "uv_connection.h"
 #include "../tcp_event_handler.h"
 #include "../tcp_server.h"
@@ -51,14 +52,25 @@ namespace moss {
 		listener_(std::make_shared<uv_tcp_t>()),
 		ipc_(std::make_shared<uv_pipe_t>()),
 		mutex_(std::make_shared<mutex>()),
-		ready_workers_(0) {
+		ready_(std::make_shared<uv_sem_t>()),
+		ready_workers_(0),
+		ready_error_(0),
+		reuse_port_(false) {
 		uv_loop_init(loop_.get());
 		uv_loop_set_data(loop_.get(), this);
+		uv_sem_init(ready_.get(), 0);
+		std::ostringstream oss;
+		oss << MIRABILIS_CHANNEL_TCP_LISTENER << "." << uv_os_getpid();
+		pipe_name_ = oss.str();
 	}
 
 	TcpServerImpl::~TcpServerImpl() {
-		uv_close((uv_handle_t*)listener_.get(), nullptr);
+		uv_handle_t* listener = (uv_handle_t*)listener_.get();
+		if (uv_handle_get_type(listener) == UV_TCP && !uv_is_closing(listener)) {
+			uv_close(listener, nullptr);
+		}
 		uv_loop_close(loop_.get());
+		uv_sem_destroy(ready_.get());
 	}
 
 	shared_ptr<uv_loop_t> TcpServerImpl::GetLoop() const {
@@ -92,6 +104,14 @@ namespace moss {
 		}
 	}
 
+	void TcpServerImpl::WorkerReady(int retval) {
+		if (retval != 0) {
+			int expected = 0;
+			ready_error_.compare_exchange_strong(expected, retval);
+		}
+		uv_sem_post(ready_.get());
+	}
+
 	shared_ptr<UvWorker> TcpServerImpl::GetWorker(int worker_id) {
 		if (worker_id >= (int)workers_.size())
 			return nullptr;
@@ -99,21 +119,48 @@ namespace moss {
 		return worker;
 	}
 
-	int TcpServerImpl::Start(const string& ip, int port, int num_of_workers/* = 16*/) {
+	int TcpServerImpl::Start(const string& ip, int port, int num_of_workers/* = 16*/, bool reuse_port/* = false*/) {
+		int retval = uv_ip4_addr(ip.c_str(), port, &listen_addr_);
+		if (retval != 0) {
+			logger::Fatal() << "uv_ip4_addr failed: " << uv_strerror(retval);
+			return retval;
+		}
+		reuse_port_ = reuse_port;
+		if (reuse_port_) {
+			retval = StartWithReusePort(num_of_workers);
+		} else {
+			retval = StartWithPipe(num_of_workers);
+		}
+		if (retval == 0) {
+			logger::Info() << "listening " << ip << ":" << port << ", workers: " << workers_.size();
+		}
+		return retval;
+	}
+
+	int TcpServerImpl::StartWithReusePort(int num_of_workers) {
+		SetupWorkers(num_of_workers);
+		StartWorkers();
+		for (size_t i = 0; i < workers_.size(); i++) {
+			uv_sem_wait(ready_.get());
+		}
+		if (0 != ready_error_) {
+			// the loops that did bind would go on serving, on part of the workers.
+			for (auto& worker : workers_) {
+				worker->Stop();
+			}
+		}
+		return ready_error_;
+	}
+
+	int TcpServerImpl::StartWithPipe(int num_of_workers) {
 		int retval = -1;
 		do {
-			struct sockaddr_in listen_addr;
-			retval = uv_ip4_addr(ip.c_str(), port, &listen_addr);
-			if (retval != 0) {
-				logger::Fatal() << "uv_ip4_addr failed: " << uv_strerror(retval);
-				break;
-			}
 			retval = uv_tcp_init(loop_.get(), listener_.get());
 			if (retval != 0) {
 				logger::Fatal() << "uv_tcp_init failed: " << uv_strerror(retval);
 				break;
 			}
-			retval = uv_tcp_bind(listener_.get(), (const struct sockaddr*)&listen_addr, 0);
+			retval = uv_tcp_bind(listener_.get(), (const struct sockaddr*)&listen_addr_, 0);
 			if (retval != 0) {
 				logger::Fatal() << "uv_tcp_bind failed: " << uv_strerror(retval);
 				break;
@@ -126,7 +173,7 @@ namespace moss {
 			}
 			uv_handle_set_data((uv_handle_t*)ipc_.get(), this);
 			uv_pipe_pending_instances(ipc_.get(), (int)workers_.size());
-			retval = uv_pipe_bind(ipc_.get(), MIRABILIS_CHANNEL_TCP_LISTENER);
+			retval = uv_pipe_bind(ipc_.get(), pipe_name_.c_str());
 			if (retval != 0) {
 				logger::Fatal() << "uv_pipe_bind failed: " << uv_strerror(retval);
 				break;
@@ -143,9 +190,9 @@ namespace moss {
 				break;
 			}
 			uv_close((uv_handle_t*)listener_.get(), nullptr);
+			uv_run(loop_.get(), UV_RUN_NOWAIT);
 			return 0;
 		} while (0);
-		logger::Info() << "listening " << ip << ":" << port;
 		return retval;
 	}
 
@@ -157,6 +204,29 @@ namespace moss {
 		return 0;
 	}
 
+	BufferPoolStats TcpServerImpl::ReadBufferStats() const {
+		BufferPoolStats stats = { 0, 0, 0 };
+		for (auto& worker : workers_) {
+			auto worker_stats = worker->ReadBufferPool()->GetStats();
+			stats.hits += worker_stats.hits;
+			stats.misses += worker_stats.misses;
+			stats.bytes_held += worker_stats.bytes_held;
+		}
+		return stats;
+	}
+
+	bool TcpServerImpl::IsReusePort() const {
+		return reuse_port_;
+	}
+
+	const struct sockaddr* TcpServerImpl::ListenAddress() const {
+		return (const struct sockaddr*)&listen_addr_;
+	}
+
+	string TcpServerImpl::PipeName() const {
+		return pipe_name_;
+	}
+
 	shared_ptr<TcpServer> TcpServerImpl::GetServer() const {
 		auto server = server_.lock();
 		return server;
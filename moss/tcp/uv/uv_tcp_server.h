@@ -19,6 +19,7 @@ using std::vector;
 using std::weak_ptr;
 namespace moss {
 	class TcpServer;
+	struct BufferPoolStats;
 	class TcpEventHandler;
 	class UvWorker;
 	class UvConnection;
@@ -33,22 +34,33 @@ namespace moss {
 		int SetupWorkers(int workers);
 		void StartWorkers();
 		void AcceptWorker();
+		void WorkerReady(int retval);
 		shared_ptr<UvWorker> GetWorker(int worker_id);
-		int Start(const string& ip, int port, int num_of_workers = 16);
+		int Start(const string& ip, int port, int num_of_workers = 16, bool reuse_port = false);
 		int Stop();
 		shared_ptr<TcpEventHandler> GetIoEventHandler() const;
+		BufferPoolStats ReadBufferStats() const;
+		bool IsReusePort() const;
+		const struct sockaddr* ListenAddress() const;
+		string PipeName() const;
 	protected:
 		shared_ptr<TcpServer> GetServer() const;
 		shared_ptr<UvWorker> GetWorker() const;
-			
+		int StartWithReusePort(int num_of_workers);
+		int StartWithPipe(int num_of_workers);
 	private:
 		weak_ptr<TcpServer> server_;
 		shared_ptr<uv_loop_t> loop_;
 		shared_ptr<uv_tcp_t> listener_;
 		shared_ptr<uv_pipe_t> ipc_;
 		shared_ptr<mutex> mutex_;
+		shared_ptr<uv_sem_t> ready_;
 		vector<shared_ptr<UvWorker>> workers_;
 		int ready_workers_;
+		std::atomic_int ready_error_;
+		bool reuse_port_;
+		struct sockaddr_in listen_addr_;
+		string pipe_name_;
 	};
 } // namespace moss
 
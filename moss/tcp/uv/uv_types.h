@@ -1,5 +1,7 @@
 #pragma once
 
+#include <climits>
+#include <cstdint>
 
 #define container_of(ptr, type, member) \
   ((type *) ((char *) (ptr) - offsetof(type, member)))
@@ -10,4 +12,20 @@
 #	define MIRABILIS_CHANNEL_TCP_LISTENER "/var/run/moss.channel.tcp-listener"
 #endif
 
+#ifndef IOV_MAX
+#	define IOV_MAX 1024
+#endif
+
 using worker_id_t = int;
+
+namespace moss {
+	// connection ids are generation tagged slot indexes, they are stored as
+	// handle data so callbacks can validate them against the worker slot map.
+	inline void* ConnectionIdToData(int64_t id) {
+		return (void*)(uintptr_t)id;
+	}
+
+	inline int64_t DataToConnectionId(void* data) {
+		return (int64_t)(uintptr_t)data;
+	}
+} // namespace moss
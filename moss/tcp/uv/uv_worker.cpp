@@ -1,14 +1,30 @@
 #include "uv_worker.h"
 
+#include <ctime>
 #include "uv_types.h"
+#include "uv_buffer_pool.h"
 #include "uv_connection.h"
 #include "uv_tcp_server.h"
 #include "../tcp_event_handler.h"
+#include "../tcp_server.h"
 #include "utils/logger.h"
 
 
 namespace moss {
 	namespace {
+		// connection id: high 32 bits slot generation, low 32 bits slot index.
+		int64_t MakeConnectionId(uint32_t index, uint32_t generation) {
+			return (int64_t)(((uint64_t)generation << 32) | index);
+		}
+
+		uint32_t ConnectionSlotIndex(int64_t id) {
+			return (uint32_t)((uint64_t)id & 0xffffffff);
+		}
+
+		uint32_t ConnectionSlotGeneration(int64_t id) {
+			return (uint32_t)((uint64_t)id >> 32);
+		}
+
 		shared_ptr<UvWorker> SharedFromLoop(uv_loop_t* loop) {
 			UvWorker* worker = static_cast<UvWorker*>(uv_loop_get_data(loop));
 			return worker->SharedFromPodPointer();
@@ -32,7 +48,7 @@ namespace moss {
 			buf->len = (unsigned long)scratch->size();
 		}
 
-		void IpcReadCallback(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+		void IpcReadCallback(uv_stream_t* handle, ssize_t /*nread*/, const uv_buf_t* /*buf*/) {
 			auto worker = SharedFromHandle(handle);
 			auto loop = worker->GetLoop();
 			auto ipc = worker->Pipe();
@@ -75,6 +91,29 @@ namespace moss {
 			if (!worker)
 				return;
 			worker->Write();
+			if (worker->IsStopping()) {
+				worker->CloseHandles();
+			}
+		}
+
+		void CloseWalkCallback(uv_handle_t* handle, void* /*arg*/) {
+			if (!uv_is_closing(handle)) {
+				uv_close(handle, nullptr);
+			}
+		}
+
+		void TimerCallback(uv_timer_t* handle) {
+			auto worker = SharedFromHandle(handle);
+			if (!worker)
+				return;
+			worker->Tick();
+		}
+
+		void CheckCallback(uv_check_t* handle) {
+			auto worker = SharedFromHandle(handle);
+			if (!worker)
+				return;
+			worker->CompleteDeferredWrites();
 		}
 	}
 
@@ -83,17 +122,37 @@ namespace moss {
 		server_(server),
 		loop_(std::make_shared<uv_loop_t>()),
 		async_(std::make_shared<uv_async_t>()),
-		mutex_(std::make_shared<mutex>()),
-		jobs_(std::make_shared<WriteJobs>()),
+		stopping_(false),
+		stopped_(false),
+		write_jobs_(nullptr),
+		check_(std::make_shared<uv_check_t>()),
+		timer_(std::make_shared<uv_timer_t>()),
+		last_second_(0),
 		listener_(std::make_shared<uv_tcp_t>()),
 		semaphore_(std::make_shared<uv_sem_t>()),
 		pipe_(std::make_shared<uv_pipe_t>()),
 		scratch_(std::make_shared<string>()),
-		connections_mutex_(std::make_shared<mutex>()),
-		connection_id_(1) {
+		read_buffer_pool_(std::make_shared<UvBufferPool>(64 * 1024, 64)),
+		write_high_watermark_(0),
+		write_low_watermark_(0),
+		timer_resolution_(100) {
 		uv_loop_init(loop_.get());
 		uv_loop_set_data(loop_.get(), this);
 		uv_async_init(loop_.get(), async_.get(), &AsyncCallback);
+		uv_check_init(loop_.get(), check_.get());
+		uv_timer_init(loop_.get(), timer_.get());
+	}
+
+	UvWorker::~UvWorker() {
+		UvWriteJob* job = write_jobs_.exchange(nullptr);
+		while (job) {
+			UvWriteJob* next = job->next;
+			delete job;
+			job = next;
+		}
+		for (auto req : write_requests_) {
+			delete req;
+		}
 	}
 
 	int UvWorker::Id() const {
@@ -110,8 +169,7 @@ namespace moss {
 	}
 
 	shared_ptr<UvWorker> UvWorker::SharedFromPodPointer() const {
-		auto server = server_.lock();
-		return server->GetWorker(id_);
+		return const_cast<UvWorker*>(this)->shared_from_this();
 	}
 
 	shared_ptr<uv_loop_t> UvWorker::GetLoop() const {
@@ -141,6 +199,22 @@ namespace moss {
 		return scratch_;
 	}
 
+	shared_ptr<UvBufferPool> UvWorker::ReadBufferPool() const {
+		return read_buffer_pool_;
+	}
+
+	size_t UvWorker::WriteHighWatermark() const {
+		return write_high_watermark_;
+	}
+
+	size_t UvWorker::WriteLowWatermark() const {
+		return write_low_watermark_;
+	}
+
+	shared_ptr<TimingWheel> UvWorker::GetTimingWheel() const {
+		return timing_wheel_;
+	}
+
 	void UvWorker::Setup() {
 		uv_sem_init(semaphore_.get(), 0);
 		thread_ = std::make_shared<thread>(&UvWorkerThreadProc, shared_from_this());
@@ -150,51 +224,161 @@ namespace moss {
 		uv_sem_post(semaphore_.get());
 	}
 
-	void UvWorker::Listen() {
-		uv_listen((uv_stream_t*)listener_.get(), SOMAXCONN, &AcceptCallback);
+	int UvWorker::Listen() {
+		return uv_listen((uv_stream_t*)listener_.get(), SOMAXCONN, &AcceptCallback);
+	}
+
+	int UvWorker::Bind(const struct sockaddr* addr) {
+		int retval = uv_tcp_init_ex(loop_.get(), listener_.get(), addr->sa_family);
+		if (retval != 0) {
+			logger::Fatal() << "uv_tcp_init_ex failed: " << uv_strerror(retval);
+			return retval;
+		}
+		uv_handle_set_data((uv_handle_t*)listener_.get(), this);
+		do {
+#ifdef SO_REUSEPORT
+			uv_os_fd_t fd;
+			retval = uv_fileno((uv_handle_t*)listener_.get(), &fd);
+			if (retval != 0) {
+				logger::Fatal() << "uv_fileno failed: " << uv_strerror(retval);
+				break;
+			}
+			int on = 1;
+			if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on))) {
+				retval = uv_translate_sys_error(errno);
+				logger::Fatal() << "setsockopt SO_REUSEPORT failed: " << uv_strerror(retval);
+				break;
+			}
+#else
+			if (id_ > 0) {
+				retval = UV_ENOTSUP;
+				logger::Fatal() << "SO_REUSEPORT is not supported";
+				break;
+			}
+#endif
+			retval = uv_tcp_bind(listener_.get(), addr, 0);
+			if (retval != 0) {
+				logger::Fatal() << "uv_tcp_bind failed: " << uv_strerror(retval);
+				break;
+			}
+			retval = Listen();
+			if (retval != 0) {
+				logger::Fatal() << "uv_listen failed: " << uv_strerror(retval);
+				break;
+			}
+			return 0;
+		} while (0);
+		uv_close((uv_handle_t*)listener_.get(), nullptr);
+		return retval;
 	}
 
+	// asks the loop to close everything it holds, which ends its uv_run, and
+	// joins the thread. a worker that was never started quits right away.
 	void UvWorker::Stop() {
-		uv_loop_close(loop_.get());
-		if (thread_) {
+		stopping_ = true;
+		WakeUp();
+		uv_sem_post(semaphore_.get());
+		if (thread_ && thread_->joinable() && !IsLoopThread()) {
 			thread_->join();
 		}
 	}
 
+	bool UvWorker::IsStopping() const {
+		return stopping_;
+	}
+
+	// loop thread: connections close through OnClose, the rest go unannounced.
+	void UvWorker::CloseHandles() {
+		{
+			std::lock_guard<mutex> lock(stop_mutex_);
+			stopped_ = true;
+		}
+		for (auto& slot : connection_slots_) {
+			if (slot.connection) {
+				slot.connection->DoClose();
+			}
+		}
+		uv_walk(loop_.get(), &CloseWalkCallback, nullptr);
+	}
+
 	void UvWorker::Run() {
 		uv_connect_t ipc_connect_req;
 		uv_handle_set_data((uv_handle_t*)&ipc_connect_req, this);
 		uv_sem_wait(semaphore_.get());
-		uv_pipe_init(loop_.get(), pipe_.get(), 1);
-		uv_handle_set_data((uv_handle_t*)pipe_.get(), this);
-		uv_pipe_connect(&ipc_connect_req, pipe_.get(), MIRABILIS_CHANNEL_TCP_LISTENER, &IpcConnectCallback);
+		auto server = GetServer();
+		if (!server)
+			return;
+		auto tcp_server = server->GetServer();
+		if (tcp_server) {
+			write_high_watermark_ = tcp_server->WriteHighWatermark();
+			write_low_watermark_ = tcp_server->WriteLowWatermark();
+			timer_resolution_ = tcp_server->TimerResolution();
+		}
+		uv_update_time(loop_.get());
+		timing_wheel_ = std::make_shared<TimingWheel>(timer_resolution_, (int64_t)uv_now(loop_.get()));
+		uv_timer_start(timer_.get(), &TimerCallback, timer_resolution_, timer_resolution_);
+		TickSecond();
+		if (stopping_) {
+			CloseHandles();
+		} else if (server->IsReusePort()) {
+			int retval = Bind(server->ListenAddress());
+			server->WorkerReady(retval);
+			if (retval != 0) {
+				CloseHandles();
+			}
+		} else {
+			string pipe_name = server->PipeName();
+			uv_pipe_init(loop_.get(), pipe_.get(), 1);
+			uv_handle_set_data((uv_handle_t*)pipe_.get(), this);
+			uv_pipe_connect(&ipc_connect_req, pipe_.get(), pipe_name.c_str(), &IpcConnectCallback);
+		}
+		server.reset();
 		uv_run(loop_.get(), UV_RUN_DEFAULT);
+		{
+			std::lock_guard<mutex> lock(stop_mutex_);
+			stopped_ = true;
+		}
 		uv_loop_close(loop_.get());
 	}
 
+	// the slot map is only touched from the loop thread, so no locking.
 	shared_ptr<UvConnection> UvWorker::CreateConnection(shared_ptr<uv_tcp_t> handle) {
-		auto connection_id = connection_id_.fetch_add(1);
-		auto connection = std::make_shared<UvConnection>(connection_id, handle, shared_from_this());
-		std::lock_guard<std::mutex> lock(*connections_mutex_);
-		connections_[connection_id] = connection;
+		uint32_t index;
+		if (free_connection_slots_.empty()) {
+			index = (uint32_t)connection_slots_.size();
+			connection_slots_.push_back(UvConnectionSlot{ nullptr, 1 });
+		} else {
+			index = free_connection_slots_.back();
+			free_connection_slots_.pop_back();
+		}
+		auto& slot = connection_slots_[index];
+		auto connection = std::make_shared<UvConnection>(MakeConnectionId(index, slot.generation), handle, shared_from_this());
+		slot.connection = connection;
 		return connection;
 	}
 
 	shared_ptr<UvConnection> UvWorker::GetConnection(int64_t id) const {
-		std::lock_guard<std::mutex> lock(*connections_mutex_);
-		auto it = connections_.find(id);
-		if (it != connections_.end()) {
-			return std::static_pointer_cast<UvConnection>(it->second);
-		}
-		return nullptr;
+		uint32_t index = ConnectionSlotIndex(id);
+		if (index >= connection_slots_.size())
+			return nullptr;
+		auto& slot = connection_slots_[index];
+		if (slot.generation != ConnectionSlotGeneration(id))
+			return nullptr;
+		return slot.connection;
 	}
 
 	void UvWorker::CloseConnection(int64_t id) {
-		std::lock_guard<std::mutex> lock(*connections_mutex_);
-		auto it = connections_.find(id);
-		if (it != connections_.end()) {
-			connections_.erase(it);
+		uint32_t index = ConnectionSlotIndex(id);
+		if (index >= connection_slots_.size())
+			return;
+		auto& slot = connection_slots_[index];
+		if (slot.generation != ConnectionSlotGeneration(id))
+			return;
+		slot.connection.reset();
+		if (0 == ++slot.generation) {
+			slot.generation = 1;
 		}
+		free_connection_slots_.push_back(index);
 	}
 
 	void UvWorker::Accept() {
@@ -215,31 +399,125 @@ namespace moss {
 		connection->Start();
 	}
 
-	void UvWorker::Write(int64_t connection_id) {
-		std::lock_guard<mutex> lock(*mutex_);
-		auto it = jobs_->find(connection_id);
-		if (it != jobs_->end()) {
-			++it->second;
-		} else {
-			jobs_->insert(std::make_pair(connection_id, 1));
+	UvWriteRequest* UvWorker::AcquireWriteRequest() {
+		if (write_requests_.empty()) {
+			return new UvWriteRequest();
+		}
+		auto req = write_requests_.back();
+		write_requests_.pop_back();
+		return req;
+	}
+
+	void UvWorker::ReleaseWriteRequest(UvWriteRequest* req) {
+		const size_t max_cached_requests = 1024;
+		req->wrbufs.clear();
+		req->bufs.clear();
+		if (write_requests_.size() >= max_cached_requests) {
+			delete req;
+			return;
+		}
+		write_requests_.push_back(req);
+	}
+
+	// any thread: push onto the job stack, only the push that finds the stack
+	// empty needs to wake the loop, later ones ride on the same wakeup.
+	void UvWorker::Write(int64_t connection_id, shared_ptr<string> wrbuf) {
+		UvWriteJob* job = new UvWriteJob{ nullptr, connection_id, wrbuf };
+		UvWriteJob* head = write_jobs_.load(std::memory_order_relaxed);
+		do {
+			job->next = head;
+		} while (!write_jobs_.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+		if (!head) {
+			WakeUp();
 		}
-		uv_async_send(async_.get());
 	}
 
+	// any thread: once the loop closed async_ nothing may signal it any more.
+	void UvWorker::WakeUp() {
+		std::lock_guard<mutex> lock(stop_mutex_);
+		if (!stopped_) {
+			uv_async_send(async_.get());
+		}
+	}
+
+	// loop thread: take the whole stack, restore submission order, queue each
+	// buffer on its connection and flush every touched connection once.
 	void UvWorker::Write() {
-		auto jobs = std::make_shared<WriteJobs>();
-		{
-			std::lock_guard<mutex> lock(*mutex_);
-			jobs->swap(*jobs_);
+		UvWriteJob* job = write_jobs_.exchange(nullptr, std::memory_order_acquire);
+		UvWriteJob* jobs = nullptr;
+		while (job) {
+			UvWriteJob* next = job->next;
+			job->next = jobs;
+			jobs = job;
+			job = next;
 		}
-		for (auto& job : *jobs) {
-			auto connection = GetConnection(job.first);
-			if (!connection) {
-				continue;
+		vector<shared_ptr<UvConnection>> scheduled;
+		while (jobs) {
+			job = jobs;
+			jobs = job->next;
+			auto connection = GetConnection(job->connection_id);
+			if (connection) {
+				connection->wq_.push_back(std::move(job->wrbuf));
+				if (!connection->write_scheduled_) {
+					connection->write_scheduled_ = true;
+					scheduled.push_back(connection);
+				}
 			}
+			delete job;
+		}
+		for (auto& connection : scheduled) {
+			connection->write_scheduled_ = false;
 			connection->Write();
 		}
 	}
+
+	void UvWorker::Tick() {
+		timing_wheel_->Advance((int64_t)uv_now(loop_.get()), [this](TimingWheel::Entry* entry) {
+			auto connection = GetConnection(entry->Id());
+			if (!connection)
+				return;
+			auto tcp_event_handler = GetIoEventHandler();
+			if (tcp_event_handler) {
+				tcp_event_handler->OnTimeout(connection);
+			}
+		});
+		// wall clock, so OnTick follows the second boundaries an HTTP date shows.
+		if ((int64_t)time(nullptr) != last_second_) {
+			TickSecond();
+		}
+	}
+
+	void UvWorker::TickSecond() {
+		last_second_ = (int64_t)time(nullptr);
+		auto tcp_event_handler = GetIoEventHandler();
+		if (tcp_event_handler) {
+			tcp_event_handler->OnTick(id_);
+		}
+	}
+
+	bool UvWorker::IsLoopThread() const {
+		return thread_ && thread_->get_id() == std::this_thread::get_id();
+	}
+
+	// writes finished synchronously report OnWrite from a check callback later
+	// in the same loop iteration, never from inside the Write call itself.
+	void UvWorker::DeferWriteCompletion(shared_ptr<UvConnection> connection, shared_ptr<string> wrbuf, int status/* = 0*/) {
+		if (completed_writes_.empty()) {
+			uv_check_start(check_.get(), &CheckCallback);
+		}
+		completed_writes_.push_back(UvDeferredWrite{ connection, wrbuf, status });
+	}
+
+	void UvWorker::CompleteDeferredWrites() {
+		vector<UvDeferredWrite> completed_writes;
+		completed_writes.swap(completed_writes_);
+		for (auto& it : completed_writes) {
+			it.connection->WriteFinished(it.wrbuf, it.status);
+		}
+		if (completed_writes_.empty()) {
+			uv_check_stop(check_.get());
+		}
+	}
 } // namespace moss
 
 
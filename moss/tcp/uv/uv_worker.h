@@ -6,29 +6,55 @@
 #include <string>
 #include <thread>
 #include <vector>
-#include <unordered_map>
 #include <uv.h>
 #include "uv_types.h"
+#include "utils/timing_wheel.h"
 
 
-using std::atomic_int64_t;
 using std::mutex;
 using std::shared_ptr;
 using std::string;
 using std::thread;
-using std::unordered_map;
 using std::vector;
 using std::weak_ptr;
 namespace moss {
 	class TcpEventHandler;
 	class TcpServerImpl;
 	class UvConnection;
+	class UvBufferPool;
+	struct UvWriteRequest {
+		uv_write_t req;
+		int64_t connection_id;
+		vector<shared_ptr<string>> wrbufs;
+		vector<uv_buf_t> bufs;
+	};
+
+	// node of the lock-free write queue, a nullptr wrbuf requests a close.
+	struct UvWriteJob {
+		UvWriteJob* next;
+		int64_t connection_id;
+		shared_ptr<string> wrbuf;
+	};
+
+	// a write finished outside of a uv write callback, reported from the check hook.
+	struct UvDeferredWrite {
+		shared_ptr<UvConnection> connection;
+		shared_ptr<string> wrbuf;
+		int status;
+	};
+
+	struct UvConnectionSlot {
+		shared_ptr<UvConnection> connection;
+		uint32_t generation;
+	};
+
 	class UvWorker
 		: public std::enable_shared_from_this<UvWorker> {
 		friend class TcpServerImpl;
-		using WriteJobs = std::unordered_map<int64_t, int64_t>;
+		using ConnectionSlots = vector<UvConnectionSlot>;
 	public:
 		UvWorker(worker_id_t id, shared_ptr<TcpServerImpl> server);
+		~UvWorker();
 		worker_id_t Id() const;
 		shared_ptr<TcpServerImpl> GetServer() const;
 		shared_ptr<TcpEventHandler> GetIoEventHandler() const;
@@ -39,33 +65,60 @@ namespace moss {
 		shared_ptr<uv_pipe_t> Pipe() const;
 		shared_ptr<string> Scratch() const;
 		shared_ptr<string> Scratch(size_t size);
+		shared_ptr<UvBufferPool> ReadBufferPool() const;
+		size_t WriteHighWatermark() const;
+		size_t WriteLowWatermark() const;
+		shared_ptr<TimingWheel> GetTimingWheel() const;
 		void Setup();
 		void Start();
-		void Listen();
+		int Listen();
+		int Bind(const struct sockaddr* addr);
 		void Stop();
+		bool IsStopping() const;
+		void CloseHandles();
 		void Run();
 
 		shared_ptr<UvConnection> CreateConnection(shared_ptr<uv_tcp_t> handle);
 		shared_ptr<UvConnection> GetConnection(int64_t id) const;
 		void CloseConnection(int64_t id);
 		void Accept();
-		void Write(int64_t connection_id);
+		UvWriteRequest* AcquireWriteRequest();
+		void ReleaseWriteRequest(UvWriteRequest* req);
+		void Write(int64_t connection_id, shared_ptr<string> wrbuf);
 		void Write();
+		void WakeUp();
+		bool IsLoopThread() const;
+		void DeferWriteCompletion(shared_ptr<UvConnection> connection, shared_ptr<string> wrbuf, int status = 0);
+		void CompleteDeferredWrites();
+		void Tick();
+		void TickSecond();
 	private:
 		worker_id_t id_;
 		weak_ptr<TcpServerImpl> server_;
 		shared_ptr<uv_loop_t> loop_;
 		shared_ptr<uv_async_t> async_;
 		shared_ptr<thread> thread_;
-		shared_ptr<mutex> mutex_;
-		shared_ptr<WriteJobs> jobs_;
+		std::atomic_bool stopping_;
+		// guards async_ against wakeups once the loop has closed it.
+		mutex stop_mutex_;
+		bool stopped_;
+		std::atomic<UvWriteJob*> write_jobs_;
+		shared_ptr<uv_check_t> check_;
+		shared_ptr<uv_timer_t> timer_;
+		shared_ptr<TimingWheel> timing_wheel_;
+		int64_t last_second_;
+		vector<UvDeferredWrite> completed_writes_;
 		shared_ptr<uv_tcp_t> listener_;
 		shared_ptr<uv_sem_t> semaphore_;
 		shared_ptr<uv_pipe_t> pipe_;
 		shared_ptr<string> scratch_;
-		shared_ptr<mutex> connections_mutex_;
-		atomic_int64_t connection_id_;
-		unordered_map<int64_t, shared_ptr<UvConnection>> connections_;
+		shared_ptr<UvBufferPool> read_buffer_pool_;
+		ConnectionSlots connection_slots_;
+		vector<uint32_t> free_connection_slots_;
+		vector<UvWriteRequest*> write_requests_;
+		size_t write_high_watermark_;
+		size_t write_low_watermark_;
+		int timer_resolution_;
 	};
 } // namespace moss
 
@@ -0,0 +1,107 @@
+#include "arena.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace moss {
+	Arena::Arena(size_t block_size/* = 4096*/)
+		: block_size_(block_size > 0 ? block_size : 4096) {
+	}
+
+	Arena::~Arena() {
+		for (auto& block : blocks_) {
+			free(block.data);
+		}
+	}
+
+	char* Arena::Allocate(size_t size) {
+		Block* block = blocks_.empty() ? nullptr : &blocks_.back();
+		if (!block || block->size - block->used < size) {
+			// leave headroom so a field that keeps growing can extend in place.
+			size_t capacity = size < block_size_ ? block_size_ : size + size / 2;
+			block = NewBlock(capacity < size ? size : capacity);
+			if (!block)
+				return nullptr;
+		}
+		char* data = block->data + block->used;
+		block->used += size;
+		return data;
+	}
+
+	StringView Arena::Copy(const char* data, size_t size) {
+		char* p = Allocate(size);
+		if (!p)
+			return StringView();
+		if (size > 0) {
+			memcpy(p, data, size);
+		}
+		return StringView(p, size);
+	}
+
+	StringView Arena::Append(const StringView& field, const char* data, size_t size) {
+		if (field.empty())
+			return Copy(data, size);
+		size_t total = field.size() + size;
+		if (!blocks_.empty()) {
+			Block& block = blocks_.back();
+			if (field.end() == block.data + block.used && block.size - block.used >= size) {
+				memcpy(block.data + block.used, data, size);
+				block.used += size;
+				return StringView(field.data(), total);
+			}
+			// a field with a block to itself, a growing body, moves with realloc.
+			if (field.data() == block.data && field.size() == block.used) {
+				char* p = (char*)realloc(block.data, total + total / 2);
+				if (p) {
+					block.data = p;
+					block.size = total + total / 2;
+					memcpy(p + field.size(), data, size);
+					block.used = total;
+					return StringView(p, total);
+				}
+			}
+		}
+		char* p = Allocate(total);
+		if (!p)
+			return StringView();
+		memcpy(p, field.data(), field.size());
+		memcpy(p + field.size(), data, size);
+		Release(field);
+		return StringView(p, total);
+	}
+
+	// gives back the space of a field that has been copied elsewhere, the
+	// whole block when the field was all of it.
+	void Arena::Release(const StringView& field) {
+		for (size_t i = 0; i < blocks_.size(); i++) {
+			Block& block = blocks_[i];
+			if (field.data() < block.data || field.end() > block.data + block.used)
+				continue;
+			if (field.data() == block.data && field.size() == block.used) {
+				free(block.data);
+				blocks_.erase(blocks_.begin() + i);
+			} else if (field.end() == block.data + block.used) {
+				block.used -= field.size();
+			}
+			return;
+		}
+	}
+
+	size_t Arena::BytesAllocated() const {
+		size_t bytes = 0;
+		for (auto& block : blocks_) {
+			bytes += block.size;
+		}
+		return bytes;
+	}
+
+	Arena::Block* Arena::NewBlock(size_t size) {
+		Block block = { (char*)malloc(size), size, 0 };
+		if (!block.data)
+			return nullptr;
+		blocks_.push_back(block);
+		return &blocks_.back();
+	}
+} // namespace moss
+
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "string_view.h"
+
+
+using std::vector;
+namespace moss {
+	// bump allocator, everything is released at once when the arena goes away.
+	class Arena {
+		struct Block {
+			char* data;
+			size_t size;
+			size_t used;
+		};
+	public:
+		Arena(size_t block_size = 4096);
+		~Arena();
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+		// nullptr when memory runs out, Copy and Append then return a view
+		// without data and leave field as it was.
+		char* Allocate(size_t size);
+		StringView Copy(const char* data, size_t size);
+		// appends to field, in place when field is the latest allocation. the
+		// copy a field outgrows is given back, so a growing body costs about
+		// 1.5x its size rather than the sum of every size it went through.
+		StringView Append(const StringView& field, const char* data, size_t size);
+		size_t BytesAllocated() const;
+	private:
+		Block* NewBlock(size_t size);
+		void Release(const StringView& field);
+		size_t block_size_;
+		vector<Block> blocks_;
+	};
+} // namespace moss
+
@@ -0,0 +1,669 @@
+#include "nfa_regex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <memory>
+
+
+using std::unique_ptr;
+namespace moss {
+	namespace {
+		struct Threads {
+			vector<int> pcs;
+			vector<const char*> captures;
+		};
+
+		struct Frame {
+			int pc;
+			// restores captures[slot] to previous when slot >= 0.
+			int slot;
+			const char* previous;
+		};
+
+		// per thread buffers reused across matches, so matching does not allocate
+		// once they have grown.
+		struct Scratch {
+			Threads current;
+			Threads next;
+			vector<unsigned> marks;
+			vector<Frame> stack;
+			vector<const char*> work;
+			unsigned generation;
+		};
+	}
+
+	struct NfaRegex::Node {
+		enum class Type {
+			Char,
+			Any,
+			Class,
+			Concat,
+			Alternate,
+			Repeat,
+			Group,
+			Begin,
+			End
+		};
+		Type type;
+		unsigned char ch;
+		// class index for Class, group number for Group (0 when not capturing).
+		int index;
+		int min;
+		// -1 for unbounded.
+		int max;
+		bool greedy;
+		vector<unique_ptr<Node>> children;
+
+		Node(Type node_type)
+			: type(node_type), ch(0), index(0), min(0), max(0), greedy(true) {
+		}
+	};
+
+	// recursive descent over the expression, one level per precedence:
+	// alternation, concatenation, quantified atom.
+	class NfaRegex::Parser {
+	public:
+		Parser(const string& expression, vector<std::bitset<256>>& classes)
+			: expression_(expression), pos_(0), groups_(0), classes_(classes) {
+		}
+
+		unique_ptr<Node> Parse(string& error) {
+			unique_ptr<Node> node = Alternate();
+			if (node && pos_ < expression_.size()) {
+				Fail("unmatched ')'");
+				node.reset();
+			}
+			error = error_;
+			return node;
+		}
+
+		size_t Groups() const {
+			return groups_;
+		}
+	private:
+		static const int kMaxRepeat = 1000;
+
+		unique_ptr<Node> Fail(const string& reason) {
+			if (error_.empty()) {
+				error_ = reason + " at " + std::to_string(pos_);
+			}
+			return nullptr;
+		}
+
+		bool More() const {
+			return pos_ < expression_.size();
+		}
+
+		char Peek() const {
+			return expression_[pos_];
+		}
+
+		unique_ptr<Node> Alternate() {
+			unique_ptr<Node> left = Concat();
+			if (!left)
+				return nullptr;
+			if (!More() || Peek() != '|')
+				return left;
+			unique_ptr<Node> node(new Node(Node::Type::Alternate));
+			node->children.push_back(std::move(left));
+			while (More() && Peek() == '|') {
+				pos_++;
+				unique_ptr<Node> right = Concat();
+				if (!right)
+					return nullptr;
+				node->children.push_back(std::move(right));
+			}
+			return node;
+		}
+
+		unique_ptr<Node> Concat() {
+			unique_ptr<Node> node(new Node(Node::Type::Concat));
+			while (More() && Peek() != '|' && Peek() != ')') {
+				unique_ptr<Node> atom = Atom();
+				if (!atom)
+					return nullptr;
+				while (More()) {
+					int min = 0, max = 0;
+					if (!Quantifier(min, max))
+						break;
+					if (atom->type == Node::Type::Begin || atom->type == Node::Type::End)
+						return Fail("nothing to repeat");
+					unique_ptr<Node> repeat(new Node(Node::Type::Repeat));
+					repeat->min = min;
+					repeat->max = max;
+					if (More() && Peek() == '?') {
+						repeat->greedy = false;
+						pos_++;
+					}
+					repeat->children.push_back(std::move(atom));
+					atom = std::move(repeat);
+				}
+				if (!error_.empty())
+					return nullptr;
+				node->children.push_back(std::move(atom));
+			}
+			return node;
+		}
+
+		// a '{' that does not form {m}, {m,} or {m,n} is a literal.
+		bool Quantifier(int& min, int& max) {
+			char ch = Peek();
+			if (ch == '*' || ch == '+' || ch == '?') {
+				min = ch == '+' ? 1 : 0;
+				max = ch == '?' ? 1 : -1;
+				pos_++;
+				return true;
+			}
+			if (ch != '{')
+				return false;
+			size_t pos = pos_ + 1;
+			if (!Number(pos, min))
+				return false;
+			max = min;
+			if (pos < expression_.size() && expression_[pos] == ',') {
+				pos++;
+				max = -1;
+				if (pos < expression_.size() && expression_[pos] != '}' && !Number(pos, max))
+					return false;
+			}
+			if (pos >= expression_.size() || expression_[pos] != '}')
+				return false;
+			pos_ = pos + 1;
+			if (min > kMaxRepeat || max > kMaxRepeat) {
+				Fail("repeat count too large");
+				return false;
+			}
+			if (max != -1 && max < min) {
+				Fail("bad repeat range");
+				return false;
+			}
+			return true;
+		}
+
+		bool Number(size_t& pos, int& value) {
+			size_t start = pos;
+			value = 0;
+			while (pos < expression_.size() && expression_[pos] >= '0' && expression_[pos] <= '9') {
+				if (value <= kMaxRepeat) {
+					value = value * 10 + (expression_[pos] - '0');
+				}
+				pos++;
+			}
+			return pos > start;
+		}
+
+		unique_ptr<Node> Atom() {
+			char ch = Peek();
+			pos_++;
+			switch (ch) {
+			case '(': {
+				unique_ptr<Node> group(new Node(Node::Type::Group));
+				if (More() && Peek() == '?') {
+					if (pos_ + 1 >= expression_.size() || expression_[pos_ + 1] != ':')
+						return Fail("lookaround is not supported");
+					pos_ += 2;
+				} else {
+					group->index = (int)++groups_;
+				}
+				unique_ptr<Node> inner = Alternate();
+				if (!inner)
+					return nullptr;
+				if (!More() || Peek() != ')')
+					return Fail("missing ')'");
+				pos_++;
+				group->children.push_back(std::move(inner));
+				return group;
+			}
+			case '[':
+				return Class();
+			case '.':
+				return unique_ptr<Node>(new Node(Node::Type::Any));
+			case '^':
+				return unique_ptr<Node>(new Node(Node::Type::Begin));
+			case '$':
+				return unique_ptr<Node>(new Node(Node::Type::End));
+			case '*':
+			case '+':
+			case '?':
+				return Fail("nothing to repeat");
+			case '\\':
+				return Escape();
+			default:
+				return Literal((unsigned char)ch);
+			}
+		}
+
+		unique_ptr<Node> Literal(unsigned char ch) {
+			unique_ptr<Node> node(new Node(Node::Type::Char));
+			node->ch = ch;
+			return node;
+		}
+
+		unique_ptr<Node> ClassNode(const std::bitset<256>& set) {
+			unique_ptr<Node> node(new Node(Node::Type::Class));
+			node->index = (int)classes_.size();
+			classes_.push_back(set);
+			return node;
+		}
+
+		unique_ptr<Node> Escape() {
+			if (!More())
+				return Fail("trailing '\\'");
+			std::bitset<256> set;
+			if (ClassEscape(Peek(), set)) {
+				pos_++;
+				return ClassNode(set);
+			}
+			int ch = CharEscape(false);
+			if (ch < 0)
+				return nullptr;
+			return Literal((unsigned char)ch);
+		}
+
+		// \d \w \s and their negations.
+		bool ClassEscape(char ch, std::bitset<256>& set) {
+			switch (ch) {
+			case 'd':
+			case 'D':
+				for (int c = '0'; c <= '9'; c++) {
+					set.set(c);
+				}
+				break;
+			case 'w':
+			case 'W':
+				for (int c = 0; c < 256; c++) {
+					if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+						set.set(c);
+					}
+				}
+				break;
+			case 's':
+			case 'S':
+				for (const char* p = " \t\n\r\f\v"; *p; p++) {
+					set.set((unsigned char)*p);
+				}
+				break;
+			default:
+				return false;
+			}
+			if (ch >= 'A' && ch <= 'Z') {
+				set.flip();
+			}
+			return true;
+		}
+
+		// the escaped character, -1 when unsupported.
+		int CharEscape(bool in_class) {
+			char ch = Peek();
+			pos_++;
+			switch (ch) {
+			case 'n': return '\n';
+			case 'r': return '\r';
+			case 't': return '\t';
+			case 'f': return '\f';
+			case 'v': return '\v';
+			case '0': return '\0';
+			case 'x': {
+				int value = 0;
+				for (int i = 0; i < 2; i++) {
+					if (!More() || !isxdigit((unsigned char)Peek())) {
+						Fail("bad \\x escape");
+						return -1;
+					}
+					char digit = Peek();
+					value = value * 16 + (isdigit((unsigned char)digit) ? digit - '0' : (tolower(digit) - 'a' + 10));
+					pos_++;
+				}
+				return value;
+			}
+			case 'b':
+				if (in_class)
+					return '\b';
+				Fail("word boundaries are not supported");
+				return -1;
+			default:
+				if (isalnum((unsigned char)ch)) {
+					Fail(isdigit((unsigned char)ch) ? "backreferences are not supported" : string("unknown escape \\") + ch);
+					return -1;
+				}
+				return (unsigned char)ch;
+			}
+		}
+
+		unique_ptr<Node> Class() {
+			std::bitset<256> set;
+			bool negate = More() && Peek() == '^';
+			if (negate) {
+				pos_++;
+			}
+			while (true) {
+				if (!More())
+					return Fail("missing ']'");
+				if (Peek() == ']') {
+					pos_++;
+					break;
+				}
+				int low = ClassAtom(set);
+				if (low == -2)
+					return nullptr;
+				if (low < 0 || pos_ + 1 >= expression_.size() || Peek() != '-' || expression_[pos_ + 1] == ']')
+					continue;
+				pos_++;
+				std::bitset<256> high_set;
+				int high = ClassAtom(high_set);
+				if (high == -2)
+					return nullptr;
+				if (high < 0) {
+					// [a-\d] keeps '-' literal, as ecmascript does.
+					set.set('-');
+					set |= high_set;
+					continue;
+				}
+				if (high < low)
+					return Fail("bad class range");
+				for (int c = low; c <= high; c++) {
+					set.set(c);
+				}
+			}
+			if (negate) {
+				set.flip();
+			}
+			return ClassNode(set);
+		}
+
+		// one class member added to set: the character, -1 for an escape class
+		// such as \d, -2 on error.
+		int ClassAtom(std::bitset<256>& set) {
+			char ch = Peek();
+			pos_++;
+			if (ch != '\\') {
+				set.set((unsigned char)ch);
+				return (unsigned char)ch;
+			}
+			if (!More()) {
+				Fail("trailing '\\'");
+				return -2;
+			}
+			if (ClassEscape(Peek(), set)) {
+				pos_++;
+				return -1;
+			}
+			int value = CharEscape(true);
+			if (value < 0)
+				return -2;
+			set.set(value);
+			return value;
+		}
+
+		const string& expression_;
+		size_t pos_;
+		size_t groups_;
+		vector<std::bitset<256>>& classes_;
+		string error_;
+	};
+
+	const size_t NfaRegex::kMaxProgram;
+
+	NfaRegex::NfaRegex()
+		: groups_(0), start_(0) {
+	}
+
+	int NfaRegex::Compile(const string& expression, string& error) {
+		program_.clear();
+		classes_.clear();
+		groups_ = 0;
+		Parser parser(expression, classes_);
+		unique_ptr<Node> root = parser.Parse(error);
+		if (!root)
+			return -1;
+		Add(Op::Save, 0);
+		if (0 != Emit(root.get())) {
+			program_.clear();
+			error = "expression too large";
+			return -1;
+		}
+		Add(Op::Save, 1);
+		Add(Op::Match);
+		groups_ = parser.Groups();
+		prefix_.clear();
+		prefix_saves_.clear();
+		for (start_ = 0; start_ < program_.size(); start_++) {
+			const Inst& inst = program_[start_];
+			if (inst.op == Op::Char) {
+				prefix_.append(1, (char)inst.ch);
+			} else if (inst.op == Op::Save) {
+				prefix_saves_.push_back(std::make_pair(inst.x, prefix_.size()));
+			} else {
+				break;
+			}
+		}
+		return 0;
+	}
+
+	size_t NfaRegex::Groups() const {
+		return groups_;
+	}
+
+	int NfaRegex::Add(Op op, int x/* = 0*/, int y/* = 0*/, unsigned char ch/* = 0*/) {
+		program_.push_back(Inst{ op, ch, x, y });
+		return (int)program_.size() - 1;
+	}
+
+	// split instructions list the preferred branch in x, so lazy repeats
+	// only swap the two targets.
+	int NfaRegex::Emit(const Node* node) {
+		if (program_.size() > kMaxProgram)
+			return -1;
+		switch (node->type) {
+		case Node::Type::Char:
+			Add(Op::Char, 0, 0, node->ch);
+			break;
+		case Node::Type::Any:
+			Add(Op::Any);
+			break;
+		case Node::Type::Class:
+			Add(Op::Class, node->index);
+			break;
+		case Node::Type::Begin:
+			Add(Op::Begin);
+			break;
+		case Node::Type::End:
+			Add(Op::End);
+			break;
+		case Node::Type::Concat:
+			for (auto& child : node->children) {
+				if (0 != Emit(child.get()))
+					return -1;
+			}
+			break;
+		case Node::Type::Group:
+			if (node->index > 0) {
+				Add(Op::Save, node->index * 2);
+			}
+			if (0 != Emit(node->children[0].get()))
+				return -1;
+			if (node->index > 0) {
+				Add(Op::Save, node->index * 2 + 1);
+			}
+			break;
+		case Node::Type::Alternate: {
+			vector<int> jumps;
+			for (size_t i = 0; i < node->children.size(); i++) {
+				int split = -1;
+				if (i + 1 < node->children.size()) {
+					split = Add(Op::Split);
+					program_[split].x = split + 1;
+				}
+				if (0 != Emit(node->children[i].get()))
+					return -1;
+				if (split >= 0) {
+					jumps.push_back(Add(Op::Jump));
+					program_[split].y = (int)program_.size();
+				}
+			}
+			for (int jump : jumps) {
+				program_[jump].x = (int)program_.size();
+			}
+			break;
+		}
+		case Node::Type::Repeat: {
+			const Node* child = node->children[0].get();
+			for (int i = 0; i < node->min; i++) {
+				if (0 != Emit(child))
+					return -1;
+			}
+			vector<int> splits;
+			if (node->max == -1) {
+				int split = Add(Op::Split);
+				if (0 != Emit(child))
+					return -1;
+				Add(Op::Jump, split);
+				splits.push_back(split);
+			} else {
+				for (int i = node->min; i < node->max; i++) {
+					splits.push_back(Add(Op::Split));
+					if (0 != Emit(child))
+						return -1;
+				}
+			}
+			int out = (int)program_.size();
+			for (int split : splits) {
+				int body = split + 1;
+				program_[split].x = node->greedy ? body : out;
+				program_[split].y = node->greedy ? out : body;
+			}
+			break;
+		}
+		}
+		return program_.size() > kMaxProgram ? -1 : 0;
+	}
+
+	bool NfaRegex::Match(const char* begin, const char* end, vector<const char*>* captures/* = nullptr*/) const {
+		if (program_.empty())
+			return false;
+		if ((size_t)(end - begin) < prefix_.size() || 0 != memcmp(begin, prefix_.data(), prefix_.size()))
+			return false;
+		static thread_local Scratch scratch;
+		// without captures to report threads carry no slots at all.
+		size_t slots = captures ? 2 * (groups_ + 1) : 0;
+		Threads& current = scratch.current;
+		Threads& next = scratch.next;
+		vector<unsigned>& marks = scratch.marks;
+		vector<Frame>& stack = scratch.stack;
+		vector<const char*>& work = scratch.work;
+		unsigned& generation = scratch.generation;
+		if (marks.size() < program_.size()) {
+			marks.resize(program_.size(), 0);
+		}
+		// marks are compared against a fresh generation, so the buffers only
+		// need a reset when it wraps.
+		if (++generation == 0) {
+			std::fill(marks.begin(), marks.end(), 0);
+			generation = 1;
+		}
+		current.pcs.clear();
+		current.captures.clear();
+		stack.clear();
+		work.assign(slots, nullptr);
+		// follows jumps, splits, saves and anchors from pc in priority order,
+		// queueing every thread that ends on a consuming instruction or Match.
+		auto add = [&](Threads& threads, int pc, const char* p) {
+			stack.push_back(Frame{ pc, -1, nullptr });
+			while (!stack.empty()) {
+				Frame frame = stack.back();
+				stack.pop_back();
+				if (frame.slot >= 0) {
+					work[frame.slot] = frame.previous;
+					continue;
+				}
+				if (marks[frame.pc] == generation)
+					continue;
+				marks[frame.pc] = generation;
+				const Inst& inst = program_[frame.pc];
+				switch (inst.op) {
+				case Op::Jump:
+					stack.push_back(Frame{ inst.x, -1, nullptr });
+					break;
+				case Op::Split:
+					stack.push_back(Frame{ inst.y, -1, nullptr });
+					stack.push_back(Frame{ inst.x, -1, nullptr });
+					break;
+				case Op::Save:
+					if ((size_t)inst.x < slots) {
+						stack.push_back(Frame{ 0, inst.x, work[inst.x] });
+						work[inst.x] = p;
+					}
+					stack.push_back(Frame{ frame.pc + 1, -1, nullptr });
+					break;
+				case Op::Begin:
+					if (p == begin) {
+						stack.push_back(Frame{ frame.pc + 1, -1, nullptr });
+					}
+					break;
+				case Op::End:
+					if (p == end) {
+						stack.push_back(Frame{ frame.pc + 1, -1, nullptr });
+					}
+					break;
+				default:
+					threads.pcs.push_back(frame.pc);
+					threads.captures.insert(threads.captures.end(), work.begin(), work.end());
+					break;
+				}
+			}
+		};
+		for (auto& save : prefix_saves_) {
+			if ((size_t)save.first < slots) {
+				work[save.first] = begin + save.second;
+			}
+		}
+		add(current, (int)start_, begin + prefix_.size());
+		for (const char* p = begin + prefix_.size(); ; p++) {
+			if (current.pcs.empty())
+				return false;
+			if (p == end) {
+				for (size_t i = 0; i < current.pcs.size(); i++) {
+					if (program_[current.pcs[i]].op != Op::Match)
+						continue;
+					if (captures) {
+						captures->assign(current.captures.begin() + i * slots, current.captures.begin() + (i + 1) * slots);
+					}
+					return true;
+				}
+				return false;
+			}
+			if (++generation == 0) {
+				std::fill(marks.begin(), marks.end(), 0);
+				generation = 1;
+			}
+			next.pcs.clear();
+			next.captures.clear();
+			unsigned char ch = (unsigned char)*p;
+			for (size_t i = 0; i < current.pcs.size(); i++) {
+				const Inst& inst = program_[current.pcs[i]];
+				bool matched = false;
+				switch (inst.op) {
+				case Op::Char:
+					matched = inst.ch == ch;
+					break;
+				case Op::Any:
+					matched = ch != '\n' && ch != '\r';
+					break;
+				case Op::Class:
+					matched = classes_[inst.x][ch];
+					break;
+				default:
+					break;
+				}
+				if (!matched)
+					continue;
+				std::copy(current.captures.begin() + i * slots, current.captures.begin() + (i + 1) * slots, work.begin());
+				add(next, current.pcs[i] + 1, p + 1);
+			}
+			current.pcs.swap(next.pcs);
+			current.captures.swap(next.captures);
+		}
+	}
+} // namespace moss
+
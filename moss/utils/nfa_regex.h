@@ -0,0 +1,58 @@
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+using std::string;
+using std::vector;
+namespace moss {
+	// thompson nfa run as a pike vm: a whole-input match with submatches in
+	// O(input * program) time, no backtracking. covers the ecmascript subset
+	// route patterns use: literals, '.', classes and \d \w \s, groups, (?:),
+	// '|', greedy and lazy * + ? {m,n}, ^ and $. backreferences, lookaround
+	// and \b fail to compile.
+	class NfaRegex {
+		enum class Op {
+			Char,
+			Any,
+			Class,
+			Split,
+			Jump,
+			Save,
+			Begin,
+			End,
+			Match
+		};
+		struct Inst {
+			Op op;
+			unsigned char ch;
+			int x;
+			int y;
+		};
+		struct Node;
+		class Parser;
+	public:
+		static const size_t kMaxProgram = 8192;
+		NfaRegex();
+		// -1 with the reason in error for unsupported or malformed syntax.
+		int Compile(const string& expression, string& error);
+		size_t Groups() const;
+		// captures gets 2 * (Groups() + 1) pointers, nullptr for unset groups.
+		bool Match(const char* begin, const char* end, vector<const char*>* captures = nullptr) const;
+	private:
+		int Emit(const Node* node);
+		int Add(Op op, int x = 0, int y = 0, unsigned char ch = 0);
+		vector<Inst> program_;
+		vector<std::bitset<256>> classes_;
+		size_t groups_;
+		// literal text every match starts with, compared up front so the vm
+		// starts at start_ with the saves it skipped already applied.
+		string prefix_;
+		vector<std::pair<int, size_t>> prefix_saves_;
+		size_t start_;
+	};
+} // namespace moss
+
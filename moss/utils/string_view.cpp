@@ -0,0 +1,138 @@
+#include "string_view.h"
+
+#include <algorithm>
+
+
+namespace moss {
+	namespace {
+		inline char LowerCase(char ch) {
+			return (ch >= 'A' && ch <= 'Z') ? (char)(ch + ('a' - 'A')) : ch;
+		}
+
+		inline bool IsSpace(char ch) {
+			return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+		}
+	}
+
+	const size_t StringView::npos;
+
+	StringView StringView::substr(size_t pos, size_t count/* = npos*/) const {
+		if (pos >= size_)
+			return StringView();
+		return StringView(data_ + pos, std::min(count, size_ - pos));
+	}
+
+	size_t StringView::find(char ch, size_t pos/* = 0*/) const {
+		if (pos >= size_)
+			return npos;
+		const void* found = memchr(data_ + pos, ch, size_ - pos);
+		return found ? (size_t)((const char*)found - data_) : npos;
+	}
+
+	size_t StringView::find(const StringView& str, size_t pos/* = 0*/) const {
+		if (str.empty())
+			return pos <= size_ ? pos : npos;
+		if (pos >= size_ || str.size_ > size_ - pos)
+			return npos;
+		const char* last = data_ + size_ - str.size_;
+		for (const char* p = data_ + pos; p <= last; p++) {
+			p = (const char*)memchr(p, str.data_[0], last - p + 1);
+			if (!p)
+				break;
+			if (0 == memcmp(p, str.data_, str.size_))
+				return (size_t)(p - data_);
+		}
+		return npos;
+	}
+
+	int StringView::compare(const StringView& other) const {
+		size_t n = std::min(size_, other.size_);
+		int retval = n > 0 ? memcmp(data_, other.data_, n) : 0;
+		if (retval != 0)
+			return retval;
+		if (size_ == other.size_)
+			return 0;
+		return size_ < other.size_ ? -1 : 1;
+	}
+
+	bool StringView::EqualsIgnoreCase(const StringView& other) const {
+		if (size_ != other.size_)
+			return false;
+		for (size_t i = 0; i < size_; i++) {
+			if (LowerCase(data_[i]) != LowerCase(other.data_[i]))
+				return false;
+		}
+		return true;
+	}
+
+	bool StringView::StartsWith(const StringView& prefix) const {
+		return prefix.size_ <= size_ && (prefix.empty() || 0 == memcmp(data_, prefix.data_, prefix.size_));
+	}
+
+	StringView StringView::Strip() const {
+		size_t start = 0, end = size_;
+		while (start < end && IsSpace(data_[start])) {
+			start++;
+		}
+		while (end > start && IsSpace(data_[end - 1])) {
+			end--;
+		}
+		return StringView(data_ + start, end - start);
+	}
+
+	string StringView::str() const {
+		return empty() ? string() : string(data_, size_);
+	}
+
+	StringView::operator string() const {
+		return str();
+	}
+
+	bool operator==(const StringView& left, const StringView& right) {
+		return left.size_ == right.size_ && (left.empty() || 0 == memcmp(left.data_, right.data_, left.size_));
+	}
+
+	bool operator!=(const StringView& left, const StringView& right) {
+		return !(left == right);
+	}
+
+	bool operator<(const StringView& left, const StringView& right) {
+		return left.compare(right) < 0;
+	}
+
+	string operator+(const string& left, const StringView& right) {
+		string retval(left);
+		return retval.append(right.data(), right.size());
+	}
+
+	string operator+(const StringView& left, const string& right) {
+		return left.str().append(right);
+	}
+
+	string operator+(const char* left, const StringView& right) {
+		string retval(left);
+		return retval.append(right.data(), right.size());
+	}
+
+	string operator+(const StringView& left, const char* right) {
+		return left.str().append(right);
+	}
+
+	std::ostream& operator<<(std::ostream& stream, const StringView& str) {
+		if (!str.empty()) {
+			stream.write(str.data(), str.size());
+		}
+		return stream;
+	}
+} // namespace moss
+
+std::size_t std::hash<moss::StringView>::operator()(const moss::StringView& s) const noexcept {
+	// FNV-1a
+	std::size_t hash = (std::size_t)14695981039346656037ULL;
+	for (char ch : s) {
+		hash ^= (unsigned char)ch;
+		hash *= (std::size_t)1099511628211ULL;
+	}
+	return hash;
+}
+
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+
+using std::string;
+namespace moss {
+	// non-owning view of a character range, the viewed memory must outlive it.
+	class StringView {
+	public:
+		static const size_t npos = (size_t)-1;
+
+		StringView()
+			: data_(nullptr), size_(0) {
+		}
+
+		StringView(const char* data, size_t size)
+			: data_(data), size_(size) {
+		}
+
+		StringView(const char* str)
+			: data_(str), size_(str ? strlen(str) : 0) {
+		}
+
+		StringView(const string& str)
+			: data_(str.data()), size_(str.size()) {
+		}
+
+		const char* data() const {
+			return data_;
+		}
+
+		size_t size() const {
+			return size_;
+		}
+
+		size_t length() const {
+			return size_;
+		}
+
+		bool empty() const {
+			return 0 == size_;
+		}
+
+		const char* begin() const {
+			return data_;
+		}
+
+		const char* end() const {
+			return data_ + size_;
+		}
+
+		char operator[](size_t index) const {
+			return data_[index];
+		}
+
+		StringView substr(size_t pos, size_t count = npos) const;
+		size_t find(char ch, size_t pos = 0) const;
+		size_t find(const StringView& str, size_t pos = 0) const;
+		int compare(const StringView& other) const;
+		bool EqualsIgnoreCase(const StringView& other) const;
+		bool StartsWith(const StringView& prefix) const;
+		StringView Strip() const;
+		string str() const;
+		operator string() const;
+
+		friend bool operator==(const StringView& left, const StringView& right);
+		friend bool operator!=(const StringView& left, const StringView& right);
+		friend bool operator<(const StringView& left, const StringView& right);
+		friend std::ostream& operator<<(std::ostream& stream, const StringView& str);
+	private:
+		const char* data_;
+		size_t size_;
+	};
+
+	string operator+(const string& left, const StringView& right);
+	string operator+(const StringView& left, const string& right);
+	string operator+(const char* left, const StringView& right);
+	string operator+(const StringView& left, const char* right);
+} // namespace moss
+
+template<>
+struct std::hash<moss::StringView> {
+	std::size_t operator()(const moss::StringView& s) const noexcept;
+};
+
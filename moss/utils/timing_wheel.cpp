@@ -0,0 +1,149 @@
+#include "timing_wheel.h"
+
+
+namespace moss {
+	namespace {
+		const int kSlotBits = 6;
+		const uint64_t kSlots = 1 << kSlotBits;
+		const uint64_t kSlotMask = kSlots - 1;
+		const int kLevels = 4;
+		const uint64_t kMaxTicks = (uint64_t)1 << (kSlotBits * kLevels);
+	}
+
+	TimingWheel::Entry::Entry(int64_t id/* = 0*/)
+		: prev_(this),
+		next_(this),
+		expires_(0),
+		id_(id) {
+	}
+
+	TimingWheel::Entry::~Entry() {
+		Unlink();
+	}
+
+	int64_t TimingWheel::Entry::Id() const {
+		return id_;
+	}
+
+	bool TimingWheel::Entry::IsScheduled() const {
+		return next_ != this;
+	}
+
+	void TimingWheel::Entry::Link(Entry* head) {
+		prev_ = head->prev_;
+		next_ = head;
+		head->prev_->next_ = this;
+		head->prev_ = this;
+	}
+
+	void TimingWheel::Entry::Unlink() {
+		prev_->next_ = next_;
+		next_->prev_ = prev_;
+		prev_ = this;
+		next_ = this;
+	}
+
+	TimingWheel::TimingWheel(int64_t resolution, int64_t now)
+		: resolution_(resolution > 0 ? resolution : 1),
+		current_(0),
+		size_(0),
+		slots_(kSlots * kLevels) {
+		current_ = (uint64_t)now / resolution_;
+	}
+
+	TimingWheel::~TimingWheel() {
+		for (auto& head : slots_) {
+			while (head.IsScheduled()) {
+				head.next_->Unlink();
+			}
+		}
+	}
+
+	int64_t TimingWheel::Resolution() const {
+		return resolution_;
+	}
+
+	size_t TimingWheel::Size() const {
+		return size_;
+	}
+
+	// rearming an already scheduled entry just moves it to its new slot.
+	void TimingWheel::Schedule(Entry* entry, int64_t timeout) {
+		if (entry->IsScheduled()) {
+			entry->Unlink();
+		} else {
+			size_++;
+		}
+		uint64_t ticks = timeout > 0 ? ((uint64_t)timeout + resolution_ - 1) / resolution_ : 1;
+		if (ticks >= kMaxTicks) {
+			ticks = kMaxTicks - 1;
+		}
+		entry->expires_ = current_ + ticks;
+		Add(entry);
+	}
+
+	void TimingWheel::Cancel(Entry* entry) {
+		if (!entry->IsScheduled())
+			return;
+		entry->Unlink();
+		size_--;
+	}
+
+	size_t TimingWheel::Advance(int64_t now, const Expired& expired) {
+		size_t count = 0;
+		uint64_t target = (uint64_t)now / resolution_;
+		while (current_ < target) {
+			current_++;
+			uint64_t index = current_ & kSlotMask;
+			if (0 == index) {
+				Cascade(1);
+			}
+			Entry& head = slots_[index];
+			Entry due;
+			if (head.IsScheduled()) {
+				due.next_ = head.next_;
+				due.prev_ = head.prev_;
+				due.next_->prev_ = &due;
+				due.prev_->next_ = &due;
+				head.next_ = &head;
+				head.prev_ = &head;
+			}
+			// the callback may rearm or cancel any entry, including pending ones in due.
+			while (due.IsScheduled()) {
+				Entry* entry = due.next_;
+				entry->Unlink();
+				size_--;
+				count++;
+				expired(entry);
+			}
+		}
+		return count;
+	}
+
+	void TimingWheel::Add(Entry* entry) {
+		uint64_t delta = entry->expires_ - current_;
+		int level = 0;
+		while (level < kLevels - 1 && delta >= ((uint64_t)1 << (kSlotBits * (level + 1)))) {
+			level++;
+		}
+		uint64_t index = (entry->expires_ >> (kSlotBits * level)) & kSlotMask;
+		entry->Link(&slots_[level * kSlots + index]);
+	}
+
+	// move the due slot of a higher level down once the level below wrapped.
+	void TimingWheel::Cascade(int level) {
+		if (level >= kLevels)
+			return;
+		uint64_t index = (current_ >> (kSlotBits * level)) & kSlotMask;
+		if (0 == index) {
+			Cascade(level + 1);
+		}
+		Entry& head = slots_[level * kSlots + index];
+		while (head.IsScheduled()) {
+			Entry* entry = head.next_;
+			entry->Unlink();
+			Add(entry);
+		}
+	}
+} // namespace moss
+
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+using std::vector;
+namespace moss {
+	// hierarchical timing wheel, not thread safe: owned and driven by one loop.
+	// schedule/cancel are O(1), Advance only touches the entries that expire
+	// plus the occasional cascade of a higher level slot.
+	class TimingWheel {
+	public:
+		class Entry {
+			friend class TimingWheel;
+		public:
+			Entry(int64_t id = 0);
+			~Entry();
+			int64_t Id() const;
+			bool IsScheduled() const;
+		private:
+			void Link(Entry* head);
+			void Unlink();
+			Entry* prev_;
+			Entry* next_;
+			uint64_t expires_;
+			int64_t id_;
+		};
+		using Expired = std::function<void(Entry* entry)>;
+
+		TimingWheel(int64_t resolution, int64_t now);
+		~TimingWheel();
+		int64_t Resolution() const;
+		size_t Size() const;
+		void Schedule(Entry* entry, int64_t timeout);
+		void Cancel(Entry* entry);
+		size_t Advance(int64_t now, const Expired& expired);
+	private:
+		void Add(Entry* entry);
+		void Cascade(int level);
+		int64_t resolution_;
+		uint64_t current_;
+		size_t size_;
+		vector<Entry> slots_;
+	};
+} // namespace moss
+
@@ -0,0 +1,62 @@
+
+#include <cstring>
+#include <string>
+
+#include "utils/arena.h"
+#include "check.h"
+
+
+using namespace std;
+using moss::Arena;
+using moss::StringView;
+
+
+// a body growing fragment by fragment behind other fields keeps one live
+// copy, the blocks it outgrew are given back.
+static void TestGrowingFieldReleasesOldCopies() {
+	Arena arena;
+	StringView url = arena.Copy("/upload", 7);
+	StringView header = arena.Copy("Content-Type", 12);
+	string fragment(1024, 'x');
+	StringView body;
+	for (int i = 0; i < 1024; i++) {
+		fragment[0] = (char)('a' + i % 26);
+		body = arena.Append(body, fragment.data(), fragment.size());
+	}
+	CHECK_EQ(1024u * 1024u, body.size());
+	CHECK(body[0] == 'a' && body[1024] == 'b' && body[1023 * 1024] == (char)('a' + 1023 % 26));
+	CHECK(url == "/upload");
+	CHECK(header == "Content-Type");
+	CHECK(arena.BytesAllocated() < 2 * body.size());
+}
+
+// consecutive fragments of the latest field stay in place.
+static void TestAppendInPlace() {
+	Arena arena;
+	StringView field = arena.Copy("Host", 4);
+	StringView grown = arena.Append(field, ": a", 3);
+	CHECK(field.data() == grown.data());
+	CHECK(grown == "Host: a");
+	CHECK_EQ(4096u, arena.BytesAllocated());
+}
+
+// an allocation that can not be met fails without disturbing what is there.
+static void TestAllocationFailure() {
+	Arena arena;
+	StringView field = arena.Copy("Host", 4);
+	size_t allocated = arena.BytesAllocated();
+	CHECK(nullptr == arena.Allocate((size_t)-1 / 2));
+	CHECK(nullptr == arena.Allocate((size_t)-1));
+	CHECK_EQ(allocated, arena.BytesAllocated());
+	CHECK(field == "Host");
+	StringView grown = arena.Append(field, ": a", 3);
+	CHECK(grown == "Host: a");
+}
+
+int main() {
+	TestGrowingFieldReleasesOldCopies();
+	TestAppendInPlace();
+	TestAllocationFailure();
+	return TEST_RESULT();
+}
+
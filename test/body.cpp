@@ -0,0 +1,109 @@
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "check.h"
+#include "client.h"
+
+
+using namespace std;
+using moss::http::Application;
+using moss::http::Request;
+using moss::http::Response;
+using moss::http::Route;
+using namespace moss::test;
+
+
+const size_t kSpillThreshold = 4096;
+const size_t kMaxBodySize = 512 * 1024;
+
+static string Pattern(size_t size) {
+	string data(size, '\0');
+	for (size_t i = 0; i < size; i++) {
+		data[i] = (char)('a' + i * 7 % 26);
+	}
+	return data;
+}
+
+// answers where the body was kept, its size and whether it reads back intact.
+class Upload
+	: public Route {
+public:
+	Upload()
+		: Route("POST", "/upload") {
+	}
+
+	int Process(shared_ptr<Request> request, shared_ptr<Response> response) override {
+		string body = request->Body();
+		char tail[16];
+		size_t tail_size = request->ReadBody(body.size() > 16 ? body.size() - 16 : 0, tail, sizeof(tail));
+		bool intact = body == Pattern(request->BodySize()) && 0 == body.compare(body.size() - tail_size, tail_size, tail, tail_size);
+		response->SetStatusCode(200);
+		response->SetPayload(string(request->IsBodySpilled() ? "file" : "memory") + " " + to_string(request->BodySize()) + (intact ? " intact" : " corrupt"));
+		return 0;
+	}
+};
+
+static string Post(int port, const string& body, bool chunked = false) {
+	string request = "POST /upload HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n";
+	if (chunked) {
+		request += "Transfer-Encoding: chunked\r\n\r\n";
+		for (size_t pos = 0; pos < body.size(); pos += 1000) {
+			string chunk = body.substr(pos, 1000);
+			char size_line[16];
+			snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk.size());
+			request += size_line + chunk + "\r\n";
+		}
+		request += "0\r\n\r\n";
+	} else {
+		request += "Content-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+	}
+	return Exchange(port, request);
+}
+
+// a body past the spill threshold moves to a temporary file and reads back
+// the same, smaller ones stay in memory.
+static void TestLargeBodySpills(int port) {
+	CHECK_EQ("memory 100 intact", BodyOf(Post(port, Pattern(100))));
+	CHECK_EQ("memory 4096 intact", BodyOf(Post(port, Pattern(kSpillThreshold))));
+	CHECK_EQ("file 4097 intact", BodyOf(Post(port, Pattern(kSpillThreshold + 1))));
+	CHECK_EQ("file 300000 intact", BodyOf(Post(port, Pattern(300000))));
+	CHECK_EQ("file 50000 intact", BodyOf(Post(port, Pattern(50000), true)));
+}
+
+// a declared length over the limit is refused before any of the body is
+// sent, a chunked body as soon as it goes over; both close the connection.
+static void TestOverLimitBodyIs413(int port) {
+	bool closed = false;
+	string reply = Exchange(port, "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + to_string(kMaxBodySize + 1) + "\r\n\r\n", &closed);
+	CHECK_EQ(0u, reply.find("HTTP/1.1 413 "));
+	CHECK_EQ("close", HeaderOf(reply, "Connection"));
+	CHECK(closed);
+	reply = Post(port, Pattern(kMaxBodySize + 1000), true);
+	CHECK_EQ(0u, reply.find("HTTP/1.1 413 "));
+	CHECK_EQ("file 524288 intact", BodyOf(Post(port, Pattern(kMaxBodySize))));
+	CHECK_EQ("file 524288 intact", BodyOf(Post(port, Pattern(kMaxBodySize), true)));
+}
+
+int main() {
+	auto server = make_shared<moss::HttpServer>();
+	server->SetBodySpillThreshold(kSpillThreshold);
+	server->SetMaxBodySize(kMaxBodySize);
+	auto application = make_shared<Application>();
+	application->Install(make_shared<Upload>());
+	server->Install(application);
+	int port = Listen(server);
+	CHECK(port > 0);
+	if (port > 0) {
+		TestLargeBodySpills(port);
+		TestOverLimitBodyIs413(port);
+	}
+	return Finish(TEST_RESULT());
+}
+
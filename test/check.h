@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+
+
+// assert style checks for the regression tests: a failed check reports where
+// it failed and the test keeps going, main returns the number of failures.
+namespace moss {
+	namespace test {
+		inline int& Failures() {
+			static int failures = 0;
+			return failures;
+		}
+	} // namespace test
+} // namespace moss
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			moss::test::Failures()++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(expected, actual) CHECK((expected) == (actual))
+
+#define TEST_RESULT() (moss::test::Failures() > 0 ? 1 : 0)
+
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "http/http_server.h"
+
+
+using std::shared_ptr;
+using std::string;
+namespace moss {
+	namespace test {
+		// starts server on a loopback port picked from the pid, skipping ports in
+		// use. one io loop with SO_REUSEPORT, so Start returns once it listens.
+		inline int Listen(shared_ptr<HttpServer> server, int workers = 4) {
+			signal(SIGPIPE, SIG_IGN);
+			server->SetIoWorkers(1);
+			server->SetReusePort(true);
+			for (int i = 0; i < 32; i++) {
+				int port = 20000 + (getpid() * 7 + i * 131) % 20000;
+				int fd = socket(AF_INET, SOCK_STREAM, 0);
+				sockaddr_in addr = {};
+				addr.sin_family = AF_INET;
+				addr.sin_port = htons((uint16_t)port);
+				addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				bool in_use = 0 == connect(fd, (sockaddr*)&addr, sizeof(addr));
+				close(fd);
+				if (!in_use && 0 == server->Start("127.0.0.1", port, workers))
+					return port;
+			}
+			return -1;
+		}
+
+		inline int Connect(int port) {
+			int fd = socket(AF_INET, SOCK_STREAM, 0);
+			sockaddr_in addr = {};
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons((uint16_t)port);
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			if (0 != connect(fd, (sockaddr*)&addr, sizeof(addr))) {
+				close(fd);
+				return -1;
+			}
+			return fd;
+		}
+
+		inline bool SendAll(int fd, const string& data) {
+			size_t sent = 0;
+			while (sent < data.size()) {
+				ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+				if (n <= 0)
+					return false;
+				sent += (size_t)n;
+			}
+			return true;
+		}
+
+		// everything the peer sends until it closes, or until nothing arrived
+		// for timeout milliseconds. closed tells which of the two ended it.
+		inline string ReadAll(int fd, bool* closed = nullptr, int timeout = 3000) {
+			string data;
+			char buffer[16384];
+			if (closed) {
+				*closed = false;
+			}
+			for (;;) {
+				pollfd pfd = { fd, POLLIN, 0 };
+				if (poll(&pfd, 1, timeout) <= 0)
+					break;
+				ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+				if (n <= 0) {
+					if (closed) {
+						*closed = true;
+					}
+					break;
+				}
+				data.append(buffer, (size_t)n);
+			}
+			return data;
+		}
+
+		// sends request on a new connection and reads the reply until close.
+		inline string Exchange(int port, const string& request, bool* closed = nullptr) {
+			int fd = Connect(port);
+			if (fd < 0)
+				return string();
+			// a server refusing the request may close before it is all sent,
+			// what it answered is still there to read.
+			SendAll(fd, request);
+			string reply = ReadAll(fd, closed);
+			close(fd);
+			return reply;
+		}
+
+		// HttpServer::Stop leaves the handler pool running, so a test that
+		// started a server leaves without unwinding it.
+		inline int Finish(int result) {
+			fflush(stdout);
+			fflush(stderr);
+			_exit(result);
+		}
+
+		// value of header name in the head of a raw response, empty when missing.
+		inline string HeaderOf(const string& response, const string& name) {
+			size_t head_end = response.find("\r\n\r\n");
+			size_t pos = response.find("\r\n" + name + ": ");
+			if (pos == string::npos || pos > head_end)
+				return string();
+			pos += name.size() + 4;
+			return response.substr(pos, response.find("\r\n", pos) - pos);
+		}
+
+		inline string BodyOf(const string& response) {
+			size_t head_end = response.find("\r\n\r\n");
+			return head_end == string::npos ? string() : response.substr(head_end + 4);
+		}
+	} // namespace test
+} // namespace moss
+
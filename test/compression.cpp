@@ -0,0 +1,104 @@
+
+#include <memory>
+#include <string>
+
+#include "http/compression.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "check.h"
+
+
+using namespace std;
+using moss::http::Compression;
+using moss::http::Request;
+using moss::http::Response;
+
+
+static string Text() {
+	string text;
+	while (text.size() < 8192) {
+		text.append("the quick brown fox jumps over the lazy dog. ");
+	}
+	return text;
+}
+
+static shared_ptr<Response> Compress(Compression& compression, const string& accept_encoding, const string& vary = string(), bool cacheable = false) {
+	auto request = make_shared<Request>(nullptr);
+	request->SetMethod("GET");
+	request->SetUrl("/");
+	if (!accept_encoding.empty()) {
+		request->SetHeader("Accept-Encoding", accept_encoding);
+	}
+	auto response = make_shared<Response>(nullptr);
+	response->SetStatusCode(200);
+	response->SetHeader("Content-Type", "text/plain; charset=utf-8");
+	if (!vary.empty()) {
+		response->SetHeader("Vary", vary);
+	}
+	response->SetPayload(Text());
+	response->SetCacheable(cacheable);
+	compression.OnAfter(request, response);
+	return response;
+}
+
+static string EncodingOf(Compression& compression, const string& accept_encoding) {
+	auto response = Compress(compression, accept_encoding);
+	const string& payload = response->Payload();
+	string encoding = response->Header("Content-Encoding");
+	// gzip output starts with its magic, deflate with a zlib header.
+	if (encoding == "gzip") {
+		CHECK(payload.size() > 2 && (unsigned char)payload[0] == 0x1f && (unsigned char)payload[1] == 0x8b);
+	} else if (encoding == "deflate") {
+		CHECK(payload.size() > 2 && (unsigned char)payload[0] == 0x78);
+	} else {
+		CHECK(Text() == payload);
+	}
+	return encoding;
+}
+
+// gzip wins ties, q=0 refuses a coding, codings not listed get the q of "*".
+static void TestNegotiation() {
+	Compression compression;
+	CHECK_EQ("gzip", EncodingOf(compression, "gzip, deflate, br"));
+	CHECK_EQ("gzip", EncodingOf(compression, "deflate, gzip"));
+	CHECK_EQ("gzip", EncodingOf(compression, "GZIP"));
+	CHECK_EQ("gzip", EncodingOf(compression, "x-gzip"));
+	CHECK_EQ("deflate", EncodingOf(compression, "deflate"));
+	CHECK_EQ("deflate", EncodingOf(compression, "gzip;q=0.4, deflate;q=0.8"));
+	CHECK_EQ("deflate", EncodingOf(compression, "gzip;q=0, *"));
+	CHECK_EQ("gzip", EncodingOf(compression, "*"));
+	CHECK_EQ("", EncodingOf(compression, "*;q=0"));
+	CHECK_EQ("", EncodingOf(compression, "identity"));
+	CHECK_EQ("", EncodingOf(compression, "br"));
+	CHECK_EQ("", EncodingOf(compression, ""));
+}
+
+// Accept-Encoding is added to whatever Vary the handler set, once.
+static void TestVary() {
+	Compression compression;
+	CHECK_EQ("Accept-Encoding", Compress(compression, "gzip")->Header("Vary"));
+	CHECK_EQ("Accept-Encoding", Compress(compression, "identity")->Header("Vary"));
+	CHECK_EQ("Origin, Accept-Encoding", Compress(compression, "gzip", "Origin")->Header("Vary"));
+	CHECK_EQ("Origin, accept-encoding", Compress(compression, "gzip", "Origin, accept-encoding")->Header("Vary"));
+	CHECK_EQ("*", Compress(compression, "gzip", "*")->Header("Vary"));
+}
+
+// a cacheable payload is compressed once per coding.
+static void TestCache() {
+	Compression compression;
+	auto first = Compress(compression, "gzip", string(), true);
+	auto second = Compress(compression, "gzip", string(), true);
+	auto deflated = Compress(compression, "deflate", string(), true);
+	CHECK(first->Payload() == second->Payload());
+	CHECK(first->Payload() != deflated->Payload());
+	CHECK_EQ(1u, compression.GetStats().cache_hits);
+	CHECK_EQ(3u, compression.GetStats().responses);
+}
+
+int main() {
+	TestNegotiation();
+	TestVary();
+	TestCache();
+	return TEST_RESULT();
+}
+
@@ -0,0 +1,241 @@
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "check.h"
+#include "client.h"
+
+
+using namespace std;
+using moss::http::Application;
+using moss::http::ExecutionPolicy;
+using moss::http::Request;
+using moss::http::Response;
+using moss::http::Route;
+using namespace moss::test;
+
+
+// "/delay?ms=&id=" answers id after sleeping ms on a pool thread, keeping
+// track of how many of them ran at once.
+class Delay
+	: public Route {
+public:
+	Delay()
+		: Route("GET", "/delay"), running_(0), most_running_(0) {
+	}
+
+	int Process(shared_ptr<Request> request, shared_ptr<Response> response) override {
+		int running = ++running_;
+		for (int most = most_running_; running > most && !most_running_.compare_exchange_weak(most, running);) {
+		}
+		this_thread::sleep_for(chrono::milliseconds(atoi(request->Query("ms").str().c_str())));
+		running_--;
+		response->SetStatusCode(200);
+		response->SetPayload(request->Query("id").str());
+		return 0;
+	}
+
+	int MostRunning() const {
+		return most_running_;
+	}
+private:
+	atomic<int> running_;
+	atomic<int> most_running_;
+};
+
+// "/inline?id=" answers id right away on the io loop.
+class Inline
+	: public Route {
+public:
+	Inline()
+		: Route("GET", "/inline") {
+		SetExecutionPolicy(ExecutionPolicy::Inline);
+	}
+
+	int Process(shared_ptr<Request> request, shared_ptr<Response> response) override {
+		response->SetStatusCode(200);
+		response->SetPayload(request->Query("id").str());
+		return 0;
+	}
+};
+
+// "/resource" answers both GET and HEAD with the same payload.
+class Resource
+	: public Route {
+public:
+	Resource()
+		: Route("GET,HEAD", "/resource") {
+		SetExecutionPolicy(ExecutionPolicy::Inline);
+	}
+
+	int Process(shared_ptr<Request> /*request*/, shared_ptr<Response> response) override {
+		response->SetStatusCode(200);
+		response->SetPayload("resource");
+		return 0;
+	}
+};
+
+// "/upload" streams its body, counting the bytes it was handed.
+class Upload
+	: public Route {
+public:
+	Upload()
+		: Route("POST", "/upload"), received_(0) {
+		SetBodyStreaming(true);
+	}
+
+	int OnBody(shared_ptr<Request> /*request*/, const char* /*data*/, size_t size) override {
+		received_ += size;
+		return 0;
+	}
+
+	int Process(shared_ptr<Request> /*request*/, shared_ptr<Response> response) override {
+		response->SetStatusCode(200);
+		return 0;
+	}
+
+	size_t Received() const {
+		return received_;
+	}
+private:
+	atomic<size_t> received_;
+};
+
+// splits a run of Content-Length framed responses into their bodies.
+static vector<string> Bodies(const string& data) {
+	vector<string> bodies;
+	size_t pos = 0;
+	while (pos < data.size()) {
+		size_t head_end = data.find("\r\n\r\n", pos);
+		if (head_end == string::npos)
+			break;
+		string head = data.substr(pos, head_end + 4 - pos);
+		size_t length = (size_t)atoi(HeaderOf(head, "Content-Length").c_str());
+		bodies.push_back(data.substr(head_end + 4, length));
+		pos = head_end + 4 + length;
+	}
+	return bodies;
+}
+
+// responses finishing in reverse order, and inline ones finishing before the
+// pool ones ahead of them, still go out in request order on one connection.
+// no more than kMaxPipelined of them are in flight at once.
+static const int kMaxPipelined = 3;
+static void TestResponsesKeepRequestOrder(int port, shared_ptr<Delay> delay) {
+	const int count = 8;
+	string requests;
+	for (int i = 0; i < count; i++) {
+		string id = to_string(i);
+		if (i % 3 == 2) {
+			requests += "GET /inline?id=" + id + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		} else {
+			requests += "GET /delay?ms=" + to_string((count - i) * 25) + "&id=" + id + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		}
+	}
+	requests += "GET /inline?id=last HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+	bool closed = false;
+	auto bodies = Bodies(Exchange(port, requests, &closed));
+	CHECK(closed);
+	CHECK_EQ((size_t)count + 1, bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		CHECK_EQ(i + 1 < bodies.size() ? to_string(i) : "last", bodies[i]);
+	}
+	CHECK(delay->MostRunning() > 0);
+	CHECK(delay->MostRunning() <= kMaxPipelined);
+}
+
+// requests split at arbitrary points across writes are answered the same.
+static void TestRequestsSplitAcrossReads(int port) {
+	string requests;
+	for (int i = 0; i < 4; i++) {
+		requests += "GET /inline?id=" + to_string(i) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	}
+	requests += "GET /delay?ms=10&id=4 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+	int fd = Connect(port);
+	CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	for (size_t pos = 0; pos < requests.size(); pos += 7) {
+		SendAll(fd, requests.substr(pos, 7));
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	auto bodies = Bodies(ReadAll(fd));
+	close(fd);
+	CHECK_EQ(5u, bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		CHECK_EQ(to_string(i), bodies[i]);
+	}
+}
+
+// a HEAD response announces the length of the GET one but carries no body,
+// so the response after it starts right behind its head.
+static void TestHeadHasNoBody(int port) {
+	string requests = "HEAD /resource HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	requests += "GET /resource HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+	bool closed = false;
+	string reply = Exchange(port, requests, &closed);
+	CHECK(closed);
+	size_t head_end = reply.find("\r\n\r\n");
+	CHECK(head_end != string::npos);
+	CHECK_EQ("8", HeaderOf(reply, "Content-Length"));
+	string rest = reply.substr(head_end + 4);
+	CHECK_EQ(0u, rest.find("HTTP/1.1 200 OK\r\n"));
+	CHECK_EQ("resource", BodyOf(rest));
+}
+
+// once the keep-alive limit is reached, what follows on the connection is
+// neither answered nor routed, so its body never reaches the route.
+static void TestNothingParsedPastKeepAliveLimit(int port, shared_ptr<Upload> upload) {
+	string requests;
+	for (int i = 0; i < 2; i++) {
+		requests += "GET /inline?id=" + to_string(i) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	}
+	requests += "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello";
+	bool closed = false;
+	auto bodies = Bodies(Exchange(port, requests, &closed));
+	CHECK(closed);
+	CHECK_EQ(2u, bodies.size());
+	CHECK_EQ(0u, upload->Received());
+}
+
+int main() {
+	auto server = make_shared<moss::HttpServer>();
+	auto application = make_shared<Application>();
+	auto delay = make_shared<Delay>();
+	application->Install(delay);
+	application->Install(make_shared<Inline>());
+	application->Install(make_shared<Resource>());
+	server->Install(application);
+	server->SetMaxPipelinedRequests(kMaxPipelined);
+	int port = Listen(server, 8);
+	CHECK(port > 0);
+	if (port > 0) {
+		TestResponsesKeepRequestOrder(port, delay);
+		TestRequestsSplitAcrossReads(port);
+		TestHeadHasNoBody(port);
+	}
+	auto limited = make_shared<moss::HttpServer>();
+	auto limited_application = make_shared<Application>();
+	auto upload = make_shared<Upload>();
+	limited_application->Install(make_shared<Inline>());
+	limited_application->Install(upload);
+	limited->Install(limited_application);
+	limited->SetMaxKeepAliveRequests(2);
+	int limited_port = Listen(limited, 1);
+	CHECK(limited_port > 0);
+	if (limited_port > 0) {
+		TestNothingParsedPastKeepAliveLimit(limited_port, upload);
+	}
+	return Finish(TEST_RESULT());
+}
+
@@ -0,0 +1,84 @@
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "http/request.h"
+#include "http/internal/request_parser.h"
+#include "check.h"
+
+
+using namespace std;
+using moss::http::Request;
+using moss::http::RequestParser;
+
+
+// a parser left idle on a keep-alive connection holds no request: the one
+// it completed is handed off and goes away with its last user.
+static void TestIdleParserHoldsNoRequest() {
+	auto parser = make_shared<RequestParser>(nullptr);
+	parser->Initalize();
+	string body(64 * 1024, 'x');
+	string data = "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+	CHECK_EQ(data.size(), parser->Parse(data.data(), data.size()));
+	CHECK(!parser->HasError());
+	CHECK(parser->IsRequestCompleted());
+	CHECK(!parser->GetRequest());
+	weak_ptr<Request> parsed;
+	{
+		auto request = parser->PopRequest();
+		CHECK(request != nullptr);
+		CHECK(request && request->KeepAlive());
+		CHECK(request && body.size() == request->BodySize());
+		CHECK(request && 1 == request.use_count());
+		parsed = request;
+	}
+	CHECK(parsed.expired());
+	CHECK(!parser->PopRequest());
+}
+
+// pipelined requests come out whole and in order, the one still arriving is
+// the only one the parser holds on to.
+static void TestPipelinedRequests() {
+	auto parser = make_shared<RequestParser>(nullptr);
+	parser->Initalize();
+	string data = "GET /a HTTP/1.1\r\nHost: localhost\r\n\r\nGET /b HTTP/1.1\r\nHost: localhost\r\n\r\nGET /c HTTP/1.1\r\nHo";
+	CHECK_EQ(data.size(), parser->Parse(data.data(), data.size()));
+	CHECK(parser->IsParsing());
+	CHECK(parser->GetRequest() != nullptr);
+	auto a = parser->PopRequest();
+	auto b = parser->PopRequest();
+	CHECK(a && a->Path() == "/a");
+	CHECK(b && b->Path() == "/b");
+	CHECK(!parser->PopRequest());
+	string rest = "st: localhost\r\n\r\n";
+	CHECK_EQ(rest.size(), parser->Parse(rest.data(), rest.size()));
+	CHECK(!parser->GetRequest());
+	auto c = parser->PopRequest();
+	CHECK(c && c->Path() == "/c");
+	CHECK(c && "localhost" == c->Header("Host"));
+}
+
+// Host and X-Forwarded-Host (X-Schema and X-Forwarded-Proto alike) set the
+// same thing, whichever of them came last wins.
+static void TestForwardedHeaderOrder() {
+	auto parser = make_shared<RequestParser>(nullptr);
+	parser->Initalize();
+	string data = "GET /a HTTP/1.1\r\nX-Forwarded-Host: proxy\r\nX-Forwarded-Proto: https\r\nHost: origin\r\nX-Schema: http\r\n\r\n"
+		"GET /b HTTP/1.1\r\nX-Schema: http\r\nHost: origin\r\nX-Forwarded-Host: proxy\r\nX-Forwarded-Proto: https\r\n\r\n";
+	CHECK_EQ(data.size(), parser->Parse(data.data(), data.size()));
+	auto a = parser->PopRequest();
+	auto b = parser->PopRequest();
+	CHECK(a && a->Host() == "origin");
+	CHECK(a && "http://origin/a" == a->Url());
+	CHECK(b && b->Host() == "proxy");
+	CHECK(b && "https://proxy/b" == b->Url());
+}
+
+int main() {
+	TestIdleParserHoldsNoRequest();
+	TestPipelinedRequests();
+	TestForwardedHeaderOrder();
+	return TEST_RESULT();
+}
+
@@ -0,0 +1,76 @@
+
+#include <memory>
+#include <string>
+
+#include "http/response.h"
+#include "check.h"
+
+
+using namespace std;
+using moss::http::Response;
+
+
+static string Serialized(int status, const string& payload, const string& content_length = string()) {
+	Response response(nullptr);
+	response.SetStatusCode(status);
+	response.SetPayload(payload);
+	if (!content_length.empty()) {
+		response.SetHeader("Content-Length", content_length);
+	}
+	auto wrbuf = response.Serialize();
+	CHECK_EQ(response.SerializedSize(), wrbuf->size());
+	return *wrbuf;
+}
+
+static bool HasContentLength(const string& response) {
+	return string::npos != response.find("\r\nContent-Length: ");
+}
+
+// every response that may carry a body is framed by Content-Length.
+static void TestContentLength() {
+	string ok = Serialized(200, "hello");
+	CHECK(string::npos != ok.find("\r\nContent-Length: 5\r\n"));
+	CHECK(ok.size() >= 9 && ok.compare(ok.size() - 9, 9, "\r\n\r\nhello") == 0);
+	string empty = Serialized(404, "");
+	CHECK(string::npos != empty.find("\r\nContent-Length: 0\r\n"));
+	string set = Serialized(200, "hello", "5");
+	CHECK_EQ(set.find("Content-Length"), set.rfind("Content-Length"));
+}
+
+// 1xx, 204 and 304 have no body, so no Content-Length either unless a 304
+// handler repeats the length of the representation on purpose.
+static void TestBodilessStatus() {
+	CHECK(!HasContentLength(Serialized(100, "")));
+	CHECK(!HasContentLength(Serialized(101, "")));
+	CHECK(!HasContentLength(Serialized(204, "")));
+	CHECK(!HasContentLength(Serialized(304, "")));
+	string not_modified = Serialized(304, "", "1234");
+	CHECK(string::npos != not_modified.find("\r\nContent-Length: 1234\r\n"));
+	string no_content = Serialized(204, "ignored");
+	CHECK(no_content.size() >= 4 && no_content.compare(no_content.size() - 4, 4, "\r\n\r\n") == 0);
+}
+
+// a handler spelling a header in lower case still replaces it, and still
+// stands in for the Content-Length derived from the payload.
+static void TestHeaderNamesIgnoreCase() {
+	Response response(nullptr);
+	response.SetStatusCode(200);
+	response.SetPayload("hello");
+	response.SetHeader("content-length", "5");
+	response.SetHeader("X-Trace", "a");
+	response.SetHeader("x-trace", "b");
+	CHECK_EQ("b", response.Header("X-TRACE"));
+	string serialized = *response.Serialize();
+	CHECK(string::npos == serialized.find("Content-Length"));
+	CHECK(string::npos != serialized.find("\r\ncontent-length: 5\r\n"));
+	CHECK(string::npos != serialized.find("\r\nX-Trace: b\r\n"));
+	CHECK(string::npos == serialized.find("x-trace"));
+}
+
+int main() {
+	TestContentLength();
+	TestBodilessStatus();
+	TestHeaderNamesIgnoreCase();
+	return TEST_RESULT();
+}
+
@@ -0,0 +1,189 @@
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "check.h"
+
+
+using namespace std;
+using moss::http::Application;
+using moss::http::Request;
+using moss::http::Response;
+using moss::http::Route;
+
+
+class Server
+	: public moss::HttpServer {
+public:
+	using moss::HttpServer::Find;
+};
+
+class Named
+	: public Route {
+public:
+	Named(const string& method, const string& path, const string& name)
+		: Route(method, path), name_(name) {
+	}
+
+	int Process(shared_ptr<Request> /*request*/, shared_ptr<Response> /*response*/) override {
+		return 0;
+	}
+
+	string name_;
+};
+
+// only answers PATCH, whatever the method string says.
+class PatchOnly
+	: public Named {
+public:
+	PatchOnly(const string& path)
+		: Named("GET", path, "patch-only") {
+	}
+
+	bool MatchMethod(const string& method) const override {
+		return method == "PATCH";
+	}
+};
+
+static shared_ptr<Request> MakeRequest(const string& method, const string& url, const string& host = "localhost") {
+	auto request = make_shared<Request>(nullptr);
+	request->SetMethod(method);
+	request->SetUrl(url);
+	request->SetHeader("Host", host);
+	return request;
+}
+
+// name of the route the request resolves to, empty when none does.
+static string Resolve(shared_ptr<Server> server, shared_ptr<Request> request) {
+	auto route = server->Find(request);
+	return route ? static_pointer_cast<Named>(route)->name_ : string();
+}
+
+static string Resolve(shared_ptr<Server> server, const string& method, const string& url, const string& host = "localhost") {
+	return Resolve(server, MakeRequest(method, url, host));
+}
+
+// method strings match the way Route::MatchMethod always has: "" and "*"
+// take everything, otherwise any list the request method is a part of.
+static void TestMethods() {
+	auto server = make_shared<Server>();
+	auto application = make_shared<Application>();
+	application->Install(make_shared<Named>("GET|POST", "/pipe", "pipe"));
+	application->Install(make_shared<Named>("GET,POST", "/comma", "comma"));
+	application->Install(make_shared<Named>("GETPOST", "/joined", "joined"));
+	application->Install(make_shared<Named>("GET POST", "/space", "space"));
+	application->Install(make_shared<Named>("*", "/any", "any"));
+	application->Install(make_shared<Named>("", "/empty", "empty"));
+	application->Install(make_shared<Named>("DELETE", "~/items/{id}", "delete"));
+	application->Install(make_shared<PatchOnly>("/patch"));
+	application->Install(make_shared<PatchOnly>("~/patch/(\\d+)"));
+	server->Install(application);
+	const char* lists[] = { "/pipe", "/comma", "/joined", "/space" };
+	for (auto path : lists) {
+		CHECK(!Resolve(server, "GET", path).empty());
+		CHECK(!Resolve(server, "POST", path).empty());
+		CHECK(Resolve(server, "PUT", path).empty());
+	}
+	CHECK_EQ("any", Resolve(server, "OPTIONS", "/any"));
+	CHECK_EQ("empty", Resolve(server, "PUT", "/empty"));
+	CHECK_EQ("delete", Resolve(server, "DELETE", "/items/7"));
+	CHECK(Resolve(server, "GET", "/items/7").empty());
+	CHECK_EQ("patch-only", Resolve(server, "PATCH", "/patch"));
+	CHECK(Resolve(server, "GET", "/patch").empty());
+	CHECK_EQ("patch-only", Resolve(server, "PATCH", "/patch/12"));
+	CHECK(Resolve(server, "GET", "/patch/12").empty());
+}
+
+static string Arg(shared_ptr<Server> server, const string& url, const string& key) {
+	auto request = MakeRequest("GET", url);
+	if (!server->Find(request))
+		return "<unrouted>";
+	return request->Path(key);
+}
+
+// captures come back by name, and bare groups as g1, g2... in order,
+// whichever engine matches them; a bracket expression opens neither. a '.'
+// outside of a param is a regex wildcard like anywhere else in the pattern.
+static void TestPatternCaptures() {
+	moss::http::PatternEngine engines[] = { moss::http::PatternEngine::Nfa, moss::http::PatternEngine::Regex };
+	for (auto engine : engines) {
+		auto server = make_shared<Server>();
+		auto application = make_shared<Application>();
+		application->SetPatternEngine(engine);
+		application->Install(make_shared<Named>("GET", "~/users/{id}/posts/{post}", "posts"));
+		application->Install(make_shared<Named>("GET", "~/files/{rest:.*}", "files"));
+		application->Install(make_shared<Named>("GET", "~/num/{id:[0-9]+}", "num"));
+		application->Install(make_shared<Named>("GET", "~/raw/(a|b)/([(x])/{n}", "raw"));
+		application->Install(make_shared<Named>("GET", "~/grp/{rest:(a)(b)}/{id}", "grp"));
+		application->Install(make_shared<Named>("GET", "~/set/[{]{id}", "set"));
+		application->Install(make_shared<Named>("GET", "~/opt/(?:x|y)(\\d)", "opt"));
+		application->Install(make_shared<Named>("GET", "~/v1.0/{id}", "dot"));
+		server->Install(application);
+		CHECK_EQ("7", Arg(server, "/users/7/posts/42", "id"));
+		CHECK_EQ("42", Arg(server, "/users/7/posts/42", "post"));
+		CHECK_EQ("a/b.txt", Arg(server, "/files/a/b.txt", "rest"));
+		CHECK_EQ("123", Arg(server, "/num/123", "id"));
+		CHECK_EQ("<unrouted>", Arg(server, "/num/12a", "id"));
+		CHECK_EQ("b", Arg(server, "/raw/b/(/9", "g1"));
+		CHECK_EQ("(", Arg(server, "/raw/b/(/9", "g2"));
+		CHECK_EQ("9", Arg(server, "/raw/b/(/9", "n"));
+		CHECK_EQ("x", Arg(server, "/raw/a/x/10", "g2"));
+		CHECK_EQ("10", Arg(server, "/raw/a/x/10", "n"));
+		CHECK_EQ("ab", Arg(server, "/grp/ab/5", "rest"));
+		CHECK_EQ("5", Arg(server, "/grp/ab/5", "id"));
+		CHECK_EQ("7", Arg(server, "/set/{7", "id"));
+		CHECK_EQ("3", Arg(server, "/opt/y3", "g1"));
+		CHECK_EQ("8", Arg(server, "/v1.0/8", "id"));
+		CHECK_EQ("9", Arg(server, "/v1x0/9", "id"));
+	}
+}
+
+static shared_ptr<Application> MakeApplication(const string& host, const string& prefix, const vector<pair<string, string>>& routes) {
+	auto application = make_shared<Application>(prefix);
+	application->SetHost(host);
+	for (auto& route : routes) {
+		application->Install(make_shared<Named>("GET", route.first, route.second));
+	}
+	return application;
+}
+
+// the host's applications first, then those for any host; within either the
+// deepest prefix ending on a segment boundary, backing off to shallower ones
+// when it has no route for the rest of the path.
+static void TestDispatch() {
+	auto server = make_shared<Server>();
+	CHECK_EQ(0, server->Install(MakeApplication("", "", { { "/", "root" }, { "/x", "root-x" }, { "/api/v1/other", "root-other" } })));
+	CHECK_EQ(0, server->Install(MakeApplication("", "/api", { { "/", "api-root" }, { "/users", "api" } })));
+	CHECK_EQ(0, server->Install(MakeApplication("", "/api/v1", { { "/users", "v1" } })));
+	CHECK_EQ(0, server->Install(MakeApplication("example.com", "", { { "/users", "host" } })));
+	CHECK_EQ(0, server->Install(MakeApplication("example.com", "/api", { { "/users", "host-api" } })));
+	CHECK_EQ(-1, server->Install(MakeApplication("", "/api/", { { "/users", "duplicate" } })));
+	CHECK_EQ("root", Resolve(server, "GET", "/"));
+	CHECK_EQ("api", Resolve(server, "GET", "/api/users"));
+	CHECK_EQ("api-root", Resolve(server, "GET", "/api"));
+	CHECK_EQ("api-root", Resolve(server, "GET", "/api/"));
+	CHECK_EQ("v1", Resolve(server, "GET", "/api/v1/users?page=2"));
+	CHECK_EQ("root-other", Resolve(server, "GET", "/api/v1/other"));
+	CHECK_EQ("", Resolve(server, "GET", "/apix/users"));
+	CHECK_EQ("host", Resolve(server, "GET", "/users", "EXAMPLE.com:8080"));
+	CHECK_EQ("host-api", Resolve(server, "GET", "/api/users", "example.com"));
+	CHECK_EQ("v1", Resolve(server, "GET", "/api/v1/users", "example.com"));
+	CHECK_EQ("root-x", Resolve(server, "GET", "/x", "example.com"));
+	CHECK_EQ("", Resolve(server, "GET", "/users", "other.com"));
+	CHECK_EQ("host", Resolve(server, "GET", "http://example.com/users", ""));
+}
+
+int main() {
+	TestMethods();
+	TestPatternCaptures();
+	TestDispatch();
+	return TEST_RESULT();
+}
+
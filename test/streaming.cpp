@@ -0,0 +1,204 @@
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "http/application.h"
+#include "http/http_server.h"
+#include "http/route.h"
+#include "http/request.h"
+#include "http/response.h"
+#include "check.h"
+#include "client.h"
+
+
+using namespace std;
+using moss::http::Application;
+using moss::http::Request;
+using moss::http::Response;
+using moss::http::Route;
+using namespace moss::test;
+
+
+// "/stream?n=&size=" streams n chunks of size bytes, chunk i filled with 'a' + i.
+class Stream
+	: public Route {
+public:
+	Stream()
+		: Route("GET", "/stream") {
+	}
+
+	int Process(shared_ptr<Request> request, shared_ptr<Response> response) override {
+		int n = atoi(request->Query("n").str().c_str());
+		size_t size = (size_t)atoi(request->Query("size").str().c_str());
+		response->SetStatusCode(200);
+		response->BeginStream();
+		for (int i = 0; i < n; i++) {
+			response->Write(string(size, (char)('a' + i % 26)));
+		}
+		response->End();
+		return 0;
+	}
+};
+
+// "/inline?n=&size=" streams like "/stream" on the io loop, stopping at the
+// first chunk the connection does not take.
+class InlineStream
+	: public Route {
+public:
+	InlineStream()
+		: Route("GET", "/inline"), written_(0) {
+		SetExecutionPolicy(moss::http::ExecutionPolicy::Inline);
+	}
+
+	int Process(shared_ptr<Request> request, shared_ptr<Response> response) override {
+		int n = atoi(request->Query("n").str().c_str());
+		size_t size = (size_t)atoi(request->Query("size").str().c_str());
+		response->SetStatusCode(200);
+		response->BeginStream();
+		int i = 0;
+		while (i < n && 0 == response->Write(string(size, (char)('a' + i % 26)))) {
+			i++;
+		}
+		written_ = i;
+		response->End();
+		return 0;
+	}
+
+	int Written() const {
+		return written_;
+	}
+private:
+	atomic<int> written_;
+};
+
+class Slow
+	: public Route {
+public:
+	Slow()
+		: Route("GET", "/slow") {
+	}
+
+	int Process(shared_ptr<Request> /*request*/, shared_ptr<Response> response) override {
+		this_thread::sleep_for(chrono::milliseconds(300));
+		response->SetStatusCode(200);
+		response->SetPayload("slow");
+		return 0;
+	}
+};
+
+static string Expected(int n, size_t size) {
+	string body;
+	for (int i = 0; i < n; i++) {
+		body.append(size, (char)('a' + i % 26));
+	}
+	return body;
+}
+
+// decodes a chunked body, false on any framing error or a missing terminator.
+static bool Dechunk(const string& data, size_t& pos, string& body) {
+	for (;;) {
+		size_t line_end = data.find("\r\n", pos);
+		if (line_end == string::npos)
+			return false;
+		char* end = nullptr;
+		size_t size = strtoul(data.c_str() + pos, &end, 16);
+		if (end != data.c_str() + line_end)
+			return false;
+		pos = line_end + 2;
+		if (0 == size)
+			return data.compare(pos, 2, "\r\n") == 0 && (pos += 2, true);
+		if (data.size() < pos + size + 2 || data.compare(pos + size, 2, "\r\n") != 0)
+			return false;
+		body.append(data, pos, size);
+		pos += size + 2;
+	}
+}
+
+static void TestChunkedFraming(int port) {
+	bool closed = false;
+	string reply = Exchange(port, "GET /stream?n=5&size=3000 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", &closed);
+	CHECK(closed);
+	CHECK_EQ(0u, reply.find("HTTP/1.1 200 OK\r\n"));
+	CHECK_EQ("chunked", HeaderOf(reply, "Transfer-Encoding"));
+	CHECK(HeaderOf(reply, "Content-Length").empty());
+	size_t pos = reply.find("\r\n\r\n") + 4;
+	string body;
+	CHECK(Dechunk(reply, pos, body));
+	CHECK_EQ(pos, reply.size());
+	CHECK(Expected(5, 3000) == body);
+}
+
+// http/1.0 has no chunked coding: the body goes out as is and ends with the
+// connection, even when the client asked to keep it alive.
+static void TestHttp10IsCloseDelimited(int port) {
+	bool closed = false;
+	string reply = Exchange(port, "GET /stream?n=4&size=100 HTTP/1.0\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n", &closed);
+	CHECK(closed);
+	CHECK_EQ(0u, reply.find("HTTP/1.1 200 OK\r\n"));
+	CHECK(HeaderOf(reply, "Transfer-Encoding").empty());
+	CHECK(HeaderOf(reply, "Content-Length").empty());
+	CHECK_EQ("close", HeaderOf(reply, "Connection"));
+	CHECK(Expected(4, 100) == BodyOf(reply));
+}
+
+// a stream behind a slow response is held back at the write high watermark
+// and still comes out whole and in order once the slow one is done.
+static void TestStreamBehindSlowResponse(int port) {
+	bool closed = false;
+	string reply = Exchange(port, "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\nGET /stream?n=64&size=1024 HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", &closed);
+	CHECK(closed);
+	size_t second = reply.find("HTTP/1.1 200 OK\r\n", 1);
+	CHECK(0 == reply.find("HTTP/1.1 200 OK\r\n") && second != string::npos);
+	CHECK_EQ("slow", BodyOf(reply.substr(0, second)));
+	string rest = reply.substr(second);
+	size_t pos = rest.find("\r\n\r\n") + 4;
+	string body;
+	CHECK(Dechunk(rest, pos, body));
+	CHECK(Expected(64, 1024) == body);
+}
+
+// the io loop can not wait for a peer that does not read: past the write
+// high watermark Write refuses the chunk instead of queueing all of them.
+static void TestInlineStreamIsRefusedPastWatermark(int port, shared_ptr<InlineStream> stream) {
+	const int n = 256;
+	const size_t size = 64 * 1024;
+	int fd = Connect(port);
+	CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	SendAll(fd, "GET /inline?n=" + to_string(n) + "&size=" + to_string(size) + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+	this_thread::sleep_for(chrono::milliseconds(200));
+	string reply = ReadAll(fd);
+	close(fd);
+	int written = stream->Written();
+	CHECK(written > 0 && written < n);
+	size_t pos = reply.find("\r\n\r\n") + 4;
+	string body;
+	CHECK(Dechunk(reply, pos, body));
+	CHECK(Expected(written, size) == body);
+}
+
+int main() {
+	auto server = make_shared<moss::HttpServer>();
+	server->SetWriteWatermarks(4096, 1024);
+	auto application = make_shared<Application>();
+	application->Install(make_shared<Stream>());
+	application->Install(make_shared<Slow>());
+	auto inline_stream = make_shared<InlineStream>();
+	application->Install(inline_stream);
+	server->Install(application);
+	int port = Listen(server);
+	CHECK(port > 0);
+	if (port > 0) {
+		TestChunkedFraming(port);
+		TestHttp10IsCloseDelimited(port);
+		TestStreamBehindSlowResponse(port);
+		TestInlineStreamIsRefusedPastWatermark(port, inline_stream);
+	}
+	return Finish(TEST_RESULT());
+}
+